@@ -0,0 +1,716 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// The bits of a cell.
+enum {
+	CELL_NEIGHBOURS = 0x0F,
+	CELL_UNCOVERED = 0x10,
+	CELL_FLAGGED = 0x20,
+	CELL_MINE = 0x40,
+	CELL_CULPRIT = 0x80
+};
+
+// A cell, packed into a byte, so that the tile of a cell can be looked up in
+// a table by its bits.
+struct Cell {
+	Uint8 bits = 0;
+
+	inline int neighbours() const {
+		return bits & CELL_NEIGHBOURS;
+	}
+	inline bool is_uncovered() const {
+		return bits & CELL_UNCOVERED;
+	}
+	inline bool is_flagged() const {
+		return bits & CELL_FLAGGED;
+	}
+	inline bool is_mine() const {
+		return bits & CELL_MINE;
+	}
+	inline bool is_culprit() const {
+		return bits & CELL_CULPRIT;
+	}
+
+	// Set or clear a bit.
+	inline void set(Uint8 bit, bool value) {
+		bits = value ? bits | bit : bits & ~bit;
+	}
+
+	// Set the neighbouring mine count.
+	inline void set_neighbours(int neighbours) {
+		bits = (bits & ~CELL_NEIGHBOURS) | neighbours;
+	}
+};
+
+// The game board is saved, loaded and mapped as an array of bytes.
+static_assert(sizeof(Cell) == 1, "A cell must be a single byte.");
+
+// Count the 3BV of a board of x by y cells: the least number of clicks that
+// clear it without flags, one per opening and one per numbered cell outside
+// the openings. The functions tell if the cell at an index is a mine and
+// give its neighbouring mine count. The marks and stack are scratch space.
+template <typename IsMine, typename Neighbours>
+Uint64 count_3bv(int x_cells, int y_cells, IsMine is_mine, Neighbours neighbours, std::vector<Uint8>& marks, std::vector<size_t>& stack) {
+	size_t cells = size_t(x_cells) * y_cells;
+	marks.assign(cells, 0);
+	Uint64 clicks = 0;
+	for (size_t c = 0; c < cells; c++) {
+		if (marks[c] || is_mine(c) || neighbours(c)) {
+			continue;
+		}
+		// Mark an opening and the numbers around it.
+		clicks++;
+		marks[c] = 1;
+		stack.assign(1, c);
+		while (!stack.empty()) {
+			size_t d = stack.back();
+			stack.pop_back();
+			int x = d % x_cells;
+			int y = d / x_cells;
+			for (int j = std::max(y - 1, 0); j <= std::min(y + 1, y_cells - 1); j++) {
+				for (int i = std::max(x - 1, 0); i <= std::min(x + 1, x_cells - 1); i++) {
+					size_t e = size_t(j) * x_cells + i;
+					if (!marks[e]) {
+						marks[e] = 1;
+						if (!neighbours(e)) {
+							stack.push_back(e);
+						}
+					}
+				}
+			}
+		}
+	}
+	for (size_t c = 0; c < cells; c++) {
+		clicks += !marks[c] && !is_mine(c);
+	}
+	return clicks;
+}
+// Pack the cells of a game board into the planes of a saved game, and find
+// the mine that lost it, if any.
+inline void pack_cells(SaveGame& saved, const Uint8* bytes, size_t cells) {
+	saved.mine = pack_plane(bytes, cells, CELL_MINE);
+	saved.uncovered = pack_plane(bytes, cells, CELL_UNCOVERED);
+	saved.flagged = pack_plane(bytes, cells, CELL_FLAGGED);
+	BitPlane culprit = pack_plane(bytes, cells, CELL_CULPRIT);
+	saved.culprit = -1;
+	for (size_t w = 0; w < culprit.size(); w++) {
+		if (culprit[w]) {
+			saved.culprit = w * 64 + trailing_zeros(culprit[w]);
+		}
+	}
+}
+
+// The cells of a game board, in row-major order. They are kept either in
+// memory, in a memory-mapped file or in a chunked file, so that boards
+// larger than memory only have the parts that are looked at or changed
+// read. A board file starts with a header for the game to keep its state
+// in. Changed cells mark their chunk dirty, and flushing writes back only
+// the dirty chunks.
+//
+// A chunked file keeps the cells in squares of 256x256, each compressed on
+// its own. It starts with the magic "MSWPCHNK", a version and the width and
+// height, padded to CHUNKED_HEADER bytes, followed by the game's header and
+// the chunk index, which has the 64-bit offset, the 32-bit size and the
+// 32-bit space of each chunk in row-major order. A chunk is its planes of
+// mines, uncovered, flagged and culprit cells (see put_plane()), followed
+// by the neighbouring mine counts of the cells around its edge, two to a
+// byte; the counts inside are recalculated from its mines. A chunk that was
+// never written has no space and is all cleared.
+//
+// Chunks are never overwritten in place: a rewritten chunk goes to free
+// space between the chunks, or at the end of the file, and its old space is
+// only freed once the index points past it, so a crash while saving leaves
+// every chunk either as it was or as it was saved.
+class Board {
+public:
+	// The size of the header of a board file, a whole number of pages on any
+	// system, so that the cells start on a page.
+	static const size_t HEADER_SIZE = 65536;
+	// The largest width and height of a board.
+	static const int MAX_SIDE = 1 << 22;
+	// The size of the board's own header in a chunked file.
+	static const size_t CHUNKED_HEADER = 64;
+	static const Uint32 CHUNKED_VERSION = 1;
+
+private:
+	// The number of cells in a chunk of a mapped file, as a power of two.
+	static const int CHUNK_SHIFT = 16;
+	// The side of a chunk of a chunked file, as a power of two.
+	static const int SQUARE_SHIFT = 8;
+
+	// The cells, and the memory holding them if they aren't mapped.
+	Cell* cells = nullptr;
+	size_t count = 0;
+	std::vector<Cell> memory;
+
+	// The mapped file and its dirty chunks, one bit each.
+	int file = -1;
+	Uint8* mapping = nullptr;
+	size_t mapping_size = 0;
+	std::vector<Uint64> dirty;
+
+	// An entry of the chunk index of a chunked file.
+	struct ChunkEntry {
+		Uint64 offset = 0;
+		Uint32 size = 0;
+		Uint32 space = 0;
+	};
+
+	// The chunked file: its width and height in cells and chunks, its index,
+	// the game's header and the end of its last chunk. The cells are kept in
+	// memory that is only backed once written, and chunks are read the first
+	// time one of their cells is, or the first time they are drawn.
+	bool chunked = false;
+	int width = 0;
+	int height = 0;
+	int x_chunks = 0;
+	int y_chunks = 0;
+	std::vector<ChunkEntry> index;
+	std::vector<Uint8> game_header;
+	Uint64 file_end = 0;
+	// The free space between the chunks, by offset and by size and offset.
+	std::map<Uint64, Uint64> free_offsets;
+	std::set<std::pair<Uint64, Uint64>> free_sizes;
+	// The chunks read so far, one bit each, and the number not read yet.
+	std::vector<Uint64> loaded;
+	size_t unloaded = 0;
+	// The cells of a chunk being read or written.
+	std::vector<Uint8> square;
+
+	// Map a file of a size, which it is extended to first if it is
+	// larger than the file.
+	bool map(std::string filename, size_t size, bool create) {
+		close();
+#ifdef _WIN32
+		return false;
+#else
+		file = ::open(filename.c_str(), create ? O_RDWR | O_CREAT : O_RDWR, 0644);
+		if (file < 0) {
+			return false;
+		}
+		struct stat status;
+		if (fstat(file, &status) != 0 || (!create && size_t(status.st_size) < HEADER_SIZE) ||
+			(create && ftruncate(file, size) != 0)) {
+			::close(file);
+			file = -1;
+			return false;
+		}
+		mapping_size = create ? size : status.st_size;
+		void* address = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+		if (address == MAP_FAILED) {
+			::close(file);
+			file = -1;
+			return false;
+		}
+		mapping = (Uint8*)address;
+		cells = (Cell*)(mapping + HEADER_SIZE);
+		count = mapping_size - HEADER_SIZE;
+		dirty.assign(((count >> CHUNK_SHIFT) + 64) / 64, 0);
+		return true;
+#endif
+	}
+
+	// Open a chunked file of x by y cells with its index, and reserve memory
+	// for its cells. The chunks that were never written are read already.
+	bool open_chunks(std::string filename, int x, int y, bool create) {
+		close();
+#ifdef _WIN32
+		return false;
+#else
+		file = ::open(filename.c_str(), create ? O_RDWR | O_CREAT : O_RDWR, 0644);
+		if (file < 0) {
+			return false;
+		}
+		std::vector<Uint8> head(CHUNKED_HEADER + HEADER_SIZE, 0);
+		struct stat status;
+		bool ok = fstat(file, &status) == 0;
+		if (create) {
+			const char* magic = "MSWPCHNK";
+			std::vector<Uint8> out(magic, magic + 8);
+			put_le(out, CHUNKED_VERSION, 4);
+			put_le(out, x, 4);
+			put_le(out, y, 4);
+			memcpy(head.data(), out.data(), out.size());
+			ok = ok && pwrite(file, head.data(), head.size(), 0) == ssize_t(head.size());
+		} else {
+			ok = ok && pread(file, head.data(), head.size(), 0) == ssize_t(head.size());
+			Reader in(head.data(), head.size());
+			const Uint8* magic = in.skip(8);
+			ok = ok && memcmp(magic, "MSWPCHNK", 8) == 0 && in.le(4) == CHUNKED_VERSION;
+			x = in.le(4);
+			y = in.le(4);
+		}
+		ok = ok && x > 0 && y > 0 && x <= MAX_SIDE && y <= MAX_SIDE;
+		width = x;
+		height = y;
+		x_chunks = (x >> SQUARE_SHIFT) + ((x & 255) != 0);
+		y_chunks = (y >> SQUARE_SHIFT) + ((y & 255) != 0);
+		size_t chunks = ok ? size_t(x_chunks) * y_chunks : 0;
+		Uint64 index_offset = CHUNKED_HEADER + HEADER_SIZE;
+		file_end = index_offset + chunks * 16;
+		std::vector<Uint8> entries(chunks * 16, 0);
+		if (create) {
+			ok = ok && ftruncate(file, file_end) == 0;
+		} else {
+			ok = ok && pread(file, entries.data(), entries.size(), index_offset) == ssize_t(entries.size());
+		}
+		index.assign(chunks, ChunkEntry());
+		Reader in(entries.data(), entries.size());
+		for (size_t c = 0; c < chunks && ok; c++) {
+			index[c].offset = in.le(8);
+			index[c].size = in.le(4);
+			index[c].space = in.le(4);
+			ok = index[c].size <= index[c].space &&
+				 (!index[c].space || (index[c].offset >= file_end && index[c].offset + index[c].size <= Uint64(status.st_size)));
+		}
+		void* address = MAP_FAILED;
+		if (ok) {
+			address = mmap(NULL, size_t(x) * y, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		}
+		if (address == MAP_FAILED) {
+			::close(file);
+			file = -1;
+			return false;
+		}
+		// Free the space between the chunks.
+		std::vector<std::pair<Uint64, Uint64>> spaces;
+		for (size_t c = 0; c < chunks; c++) {
+			if (index[c].space) {
+				spaces.push_back(std::make_pair(index[c].offset, Uint64(index[c].space)));
+			}
+		}
+		std::sort(spaces.begin(), spaces.end());
+		free_offsets.clear();
+		free_sizes.clear();
+		for (const std::pair<Uint64, Uint64>& space: spaces) {
+			if (space.first > file_end) {
+				release(file_end, space.first - file_end);
+			}
+			file_end = std::max(file_end, space.first + space.second);
+		}
+		chunked = true;
+		cells = (Cell*)address;
+		count = size_t(x) * y;
+		game_header.assign(head.begin() + CHUNKED_HEADER, head.end());
+		dirty.assign((chunks + 63) / 64, 0);
+		loaded.assign((chunks + 63) / 64, 0);
+		unloaded = chunks;
+		for (size_t c = 0; c < chunks; c++) {
+			if (!index[c].space) {
+				loaded[c / 64] |= Uint64(1) << (c % 64);
+				unloaded--;
+			}
+		}
+		return true;
+#endif
+	}
+
+	// The cells of chunk c: its first cell and its width and height.
+	size_t chunk_cells(size_t c, int& w, int& h) {
+		int x = c % x_chunks << SQUARE_SHIFT;
+		int y = c / x_chunks << SQUARE_SHIFT;
+		w = std::min(width - x, 1 << SQUARE_SHIFT);
+		h = std::min(height - y, 1 << SQUARE_SHIFT);
+		return size_t(y) * width + x;
+	}
+
+	// Check if a cell of a chunk of w by h cells is on its edge.
+	static bool is_edge(int x, int y, int w, int h) {
+		return x == 0 || y == 0 || x == w - 1 || y == h - 1;
+	}
+
+	// Read chunk c into memory.
+	void load(size_t c) {
+		loaded[c / 64] |= Uint64(1) << (c % 64);
+		unloaded--;
+#ifndef _WIN32
+		int w;
+		int h;
+		size_t first = chunk_cells(c, w, h);
+		size_t n = size_t(w) * h;
+		std::vector<Uint8> data(index[c].size);
+		square.assign(n, 0);
+		Reader in(data.data(), data.size());
+		BitPlane plane;
+		bool ok = pread(file, data.data(), data.size(), index[c].offset) == ssize_t(data.size());
+		const Uint8 masks[] = {CELL_MINE, CELL_UNCOVERED, CELL_FLAGGED, CELL_CULPRIT};
+		for (Uint8 mask: masks) {
+			ok = ok && get_plane(in, plane, n);
+			if (ok) {
+				unpack_plane(plane, square.data(), n, mask);
+			}
+		}
+		// Count the mines around the cells inside, a column of three rows at
+		// a time, and take the counts of the edge from the chunk.
+		std::vector<Uint8> columns(w, 0);
+		size_t edge = 0;
+		for (int y = 0; y < h && ok; y++) {
+			Uint8* row = square.data() + size_t(y) * w;
+			for (int x = 0; x < w && y > 0 && y < h - 1; x++) {
+				columns[x] = ((row[x - w] & CELL_MINE) + (row[x] & CELL_MINE) + (row[x + w] & CELL_MINE)) / CELL_MINE;
+			}
+			for (int x = 0; x < w; x++) {
+				if (is_edge(x, y, w, h)) {
+					const Uint8* nibble = in.data + edge / 2;
+					if (nibble >= in.end) {
+						ok = false;
+						break;
+					}
+					row[x] |= (*nibble >> (edge % 2 * 4)) & CELL_NEIGHBOURS;
+					edge++;
+				} else {
+					row[x] |= columns[x - 1] + columns[x] + columns[x + 1];
+				}
+			}
+		}
+		in.skip((edge + 1) / 2);
+		if (!ok || !in.done()) {
+			fprintf(stderr, "Chunk %zu of the board file is corrupt, so it was cleared.\n", c);
+			return;
+		}
+		for (int y = 0; y < h; y++) {
+			memcpy(cells + first + size_t(y) * width, square.data() + size_t(y) * w, w);
+		}
+#endif
+	}
+
+	// Compress chunk c.
+	void put_chunk(std::vector<Uint8>& out, size_t c) {
+		int w;
+		int h;
+		size_t first = chunk_cells(c, w, h);
+		size_t n = size_t(w) * h;
+		square.resize(n);
+		for (int y = 0; y < h; y++) {
+			memcpy(square.data() + size_t(y) * w, cells + first + size_t(y) * width, w);
+		}
+		const Uint8 masks[] = {CELL_MINE, CELL_UNCOVERED, CELL_FLAGGED, CELL_CULPRIT};
+		for (Uint8 mask: masks) {
+			put_plane(out, pack_plane(square.data(), n, mask), n);
+		}
+		size_t edge = 0;
+		for (int y = 0; y < h; y++) {
+			for (int x = 0; x < w; x++) {
+				if (is_edge(x, y, w, h)) {
+					Uint8 neighbours = square[size_t(y) * w + x] & CELL_NEIGHBOURS;
+					if (edge % 2) {
+						out.back() |= neighbours << 4;
+					} else {
+						out.push_back(neighbours);
+					}
+					edge++;
+				}
+			}
+		}
+	}
+
+	// Free space of a chunked file, merging it with the free space around
+	// it. Space at the end of the file is given back instead.
+	void release(Uint64 offset, Uint64 size) {
+		auto next = free_offsets.lower_bound(offset);
+		if (next != free_offsets.end() && next->first == offset + size) {
+			size += next->second;
+			free_sizes.erase(std::make_pair(next->second, next->first));
+			next = free_offsets.erase(next);
+		}
+		if (next != free_offsets.begin()) {
+			auto previous = std::prev(next);
+			if (previous->first + previous->second == offset) {
+				offset = previous->first;
+				size += previous->second;
+				free_sizes.erase(std::make_pair(previous->second, previous->first));
+				free_offsets.erase(previous);
+			}
+		}
+		if (offset + size == file_end) {
+			file_end = offset;
+			return;
+		}
+		free_offsets[offset] = size;
+		free_sizes.insert(std::make_pair(size, offset));
+	}
+
+	// Take space for a chunk from the smallest free space it fits in, or
+	// from the end of the file.
+	Uint64 allocate(Uint64 size) {
+		auto fit = free_sizes.lower_bound(std::make_pair(size, Uint64(0)));
+		if (fit == free_sizes.end()) {
+			file_end += size;
+			return file_end - size;
+		}
+		Uint64 offset = fit->second;
+		Uint64 left = fit->first - size;
+		free_sizes.erase(fit);
+		free_offsets.erase(offset);
+		if (left) {
+			free_offsets[offset + size] = left;
+			free_sizes.insert(std::make_pair(left, offset + size));
+		}
+		return offset;
+	}
+
+	// Write the dirty chunks of a chunked file and the game's header back to
+	// it. The chunks are written to free space and synced before the index
+	// points to them, and their old space is freed after.
+	void flush_chunks() {
+#ifndef _WIN32
+		std::vector<Uint8> out;
+		std::vector<size_t> written;
+		std::vector<ChunkEntry> old;
+		bool ok = true;
+		for (size_t w = 0; w < dirty.size(); w++) {
+			while (dirty[w]) {
+				size_t c = w * 64 + trailing_zeros(dirty[w]);
+				dirty[w] &= dirty[w] - 1;
+				if (c >= index.size()) {
+					continue;
+				}
+				out.clear();
+				put_chunk(out, c);
+				ChunkEntry& chunk = index[c];
+				old.push_back(chunk);
+				written.push_back(c);
+				chunk.offset = allocate(out.size());
+				chunk.size = out.size();
+				chunk.space = out.size();
+				if (pwrite(file, out.data(), out.size(), chunk.offset) != ssize_t(out.size())) {
+					fprintf(stderr, "Could not write chunk %zu of the board file.\n", c);
+					ok = false;
+				}
+			}
+		}
+		ok = fsync(file) == 0 && ok;
+		if (!ok) {
+			// Keep the index pointing to the chunks as they were, and try
+			// again next time.
+			for (size_t i = 0; i < written.size(); i++) {
+				size_t c = written[i];
+				release(index[c].offset, index[c].space);
+				index[c] = old[i];
+				dirty[c / 64] |= Uint64(1) << (c % 64);
+			}
+			fprintf(stderr, "Could not save the board file.\n");
+			return;
+		}
+		// Point the index to the new chunks, then free the old ones.
+		Uint64 index_offset = CHUNKED_HEADER + HEADER_SIZE;
+		std::vector<Uint8> entry;
+		for (size_t c: written) {
+			entry.clear();
+			put_le(entry, index[c].offset, 8);
+			put_le(entry, index[c].size, 4);
+			put_le(entry, index[c].space, 4);
+			if (pwrite(file, entry.data(), entry.size(), index_offset + c * 16) != ssize_t(entry.size())) {
+				ok = false;
+			}
+		}
+		if (pwrite(file, game_header.data(), HEADER_SIZE, CHUNKED_HEADER) != ssize_t(HEADER_SIZE)) {
+			ok = false;
+		}
+		if (fsync(file) != 0 || !ok) {
+			// The index on the disk may point to either, so neither is freed,
+			// and the chunks are written again next time.
+			for (size_t c: written) {
+				dirty[c / 64] |= Uint64(1) << (c % 64);
+			}
+			fprintf(stderr, "Could not write the index of the board file.\n");
+			return;
+		}
+		for (const ChunkEntry& chunk: old) {
+			if (chunk.space) {
+				release(chunk.offset, chunk.space);
+			}
+		}
+		if (ftruncate(file, file_end) != 0) {
+			fprintf(stderr, "Could not shrink the board file.\n");
+		}
+#endif
+	}
+
+	// Read every chunk of a chunked file with a cell in columns x0 to x1 and
+	// rows y0 to y1 (exclusive) that hasn't been read yet.
+	void fetch_chunks(int x0, int y0, int x1, int y1) {
+		for (int v = y0 >> SQUARE_SHIFT; v <= (y1 - 1) >> SQUARE_SHIFT; v++) {
+			for (int u = x0 >> SQUARE_SHIFT; u <= (x1 - 1) >> SQUARE_SHIFT; u++) {
+				size_t c = size_t(v) * x_chunks + u;
+				if (!((loaded[c / 64] >> (c % 64)) & 1)) {
+					load(c);
+				}
+			}
+		}
+	}
+
+public:
+	// Null constructor.
+	Board() {}
+
+	// Destructor. A board kept in a file is flushed.
+	~Board() {
+		close();
+	}
+
+	Board(const Board&) = delete;
+	Board& operator=(const Board&) = delete;
+
+	// Keep a number of cells in memory, all cleared.
+	void resize(size_t n) {
+		close();
+		memory.assign(n, Cell());
+		cells = memory.data();
+		count = n;
+	}
+
+	// Create a board file of a number of cells, all cleared, and map it.
+	// Returns false if it can't be created.
+	bool create(std::string filename, size_t n) {
+		return map(filename, HEADER_SIZE + n, true);
+	}
+
+	// Create a chunked board file of x by y cells, all cleared. Returns false
+	// if it can't be created.
+	bool create_chunked(std::string filename, int x, int y) {
+		return open_chunks(filename, x, y, true);
+	}
+
+	// Open an existing board file, mapped or chunked. Returns false if it
+	// can't be opened.
+	bool open(std::string filename) {
+		char magic[8];
+		FILE* probe = fopen(filename.c_str(), "rb");
+		bool chunks = probe && fread(magic, 1, 8, probe) == 8 && memcmp(magic, "MSWPCHNK", 8) == 0;
+		if (probe) {
+			fclose(probe);
+		}
+		if (chunks) {
+			return open_chunks(filename, 0, 0, false);
+		}
+		return map(filename, 0, false);
+	}
+
+	// Flush and close a board file, or free a board in memory.
+	void close() {
+#ifndef _WIN32
+		if (mapping) {
+			flush();
+			munmap(mapping, mapping_size);
+			::close(file);
+			mapping = nullptr;
+			file = -1;
+		}
+		if (chunked) {
+			flush();
+			munmap(cells, count);
+			::close(file);
+			chunked = false;
+			file = -1;
+			index.clear();
+			unloaded = 0;
+		}
+#endif
+		memory.clear();
+		memory.shrink_to_fit();
+		cells = nullptr;
+		count = 0;
+	}
+
+	// Check if the board is kept in a file, mapped or chunked.
+	bool is_mapped() const {
+		return mapping != nullptr || chunked;
+	}
+
+	// The header of a board file, HEADER_SIZE bytes long.
+	Uint8* header() {
+		return chunked ? game_header.data() : mapping;
+	}
+
+	// The cells. The chunk of a cell of a chunked file is read first, if it
+	// hasn't been.
+	inline Cell& operator[](size_t i) {
+		if (unloaded) {
+			fetch(i % width, i / width, i % width + 1, i / width + 1);
+		}
+		return cells[i];
+	}
+	inline Cell* data() {
+		return cells;
+	}
+	inline size_t size() const {
+		return count;
+	}
+	inline Cell* begin() {
+		return cells;
+	}
+	inline Cell* end() {
+		return cells + count;
+	}
+
+	// Read the cells in columns x0 to x1 and rows y0 to y1 (exclusive) of a
+	// chunked file, if they haven't been, so that they can be used through
+	// data(), such as by the threads drawing them.
+	inline void fetch(int x0, int y0, int x1, int y1) {
+		if (unloaded && x0 < x1 && y0 < y1) {
+			fetch_chunks(x0, y0, x1, y1);
+		}
+	}
+
+	// Mark the chunk of a changed cell dirty.
+	inline void touch(size_t i) {
+		if (mapping) {
+			size_t chunk = i >> CHUNK_SHIFT;
+			dirty[chunk / 64] |= Uint64(1) << (chunk % 64);
+		} else if (chunked) {
+			size_t chunk = size_t(i / width >> SQUARE_SHIFT) * x_chunks + (i % width >> SQUARE_SHIFT);
+			dirty[chunk / 64] |= Uint64(1) << (chunk % 64);
+		}
+	}
+
+	// Mark every chunk dirty. Every cell of a chunked file is taken as
+	// written, so it is never read.
+	void touch_all() {
+		std::fill(dirty.begin(), dirty.end(), ~Uint64(0));
+		if (chunked) {
+			std::fill(loaded.begin(), loaded.end(), ~Uint64(0));
+			unloaded = 0;
+		}
+	}
+
+	// Write the header and the dirty chunks of a board file back to it.
+	void flush() {
+#ifndef _WIN32
+		if (chunked) {
+			flush_chunks();
+			return;
+		}
+		if (!mapping) {
+			return;
+		}
+		msync(mapping, HEADER_SIZE, MS_SYNC);
+		// Chunks start on page boundaries, like the cells.
+		size_t chunk_size = size_t(1) << CHUNK_SHIFT;
+		for (size_t w = 0; w < dirty.size(); w++) {
+			while (dirty[w]) {
+				size_t chunk = w * 64 + trailing_zeros(dirty[w]);
+				dirty[w] &= dirty[w] - 1;
+				size_t begin = chunk * chunk_size;
+				if (begin < count) {
+					msync(mapping + HEADER_SIZE + begin, std::min(chunk_size, count - begin), MS_SYNC);
+				}
+			}
+		}
+#endif
+	}
+};
\ No newline at end of file
@@ -0,0 +1,465 @@
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+
+#include <SDL.h>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/resource.h>
+#endif
+
+#include "Palette.hpp"
+#include "Sprite.hpp"
+#include "Sheets.hpp"
+#include "Png.hpp"
+#include "Upscale.hpp"
+#include "Random.hpp"
+#include "Codec.hpp"
+#include "Writer.hpp"
+#include "SaveGame.hpp"
+#include "Board.hpp"
+#include "Replay.hpp"
+#include "Journal.hpp"
+#include "Graphics.hpp"
+#include "Screenshot.hpp"
+#include "Video.hpp"
+#include "Pacer.hpp"
+#include "ThreadPool.hpp"
+#include "Timeline.hpp"
+#include "Minimap.hpp"
+#include "DigitDisplay.hpp"
+#include "Stats.hpp"
+#include "Minesweeper.hpp"
+#include "Corpus.hpp"
+
+// Round-trip checks of the file formats. Each check writes something in a
+// format, reads it back and compares. Run them with "./build.sh check".
+
+// The number of checks that failed.
+int failures = 0;
+
+// Report the result of a check.
+void check(const char* name, bool ok) {
+	printf("%s %s\n", ok ? "ok    " : "FAILED", name);
+	if (!ok) {
+		failures++;
+	}
+}
+
+// Make a bit plane of n bits, each set with a chance of one in odds. Long
+// runs of equal bits are stored as runs and dense planes as raw bits, so
+// different odds cover both.
+BitPlane random_plane(Random& random, size_t n, Uint32 odds) {
+	BitPlane plane((n + 63) / 64, 0);
+	for (size_t i = 0; i < n; i++) {
+		if (random.below(odds) == 0) {
+			plane[i / 64] |= Uint64(1) << (i % 64);
+		}
+	}
+	return plane;
+}
+
+// A saved game reads back as it was written.
+void check_save_game() {
+	Random random(41);
+	SaveGame saved;
+	saved.x_cells = 67;
+	saved.y_cells = 45;
+	saved.mines = 500;
+	saved.seed = random.next();
+	saved.random = random.next();
+	saved.state = 3;
+	saved.elapsed = 123456;
+	saved.culprit = 2999;
+	size_t cells = size_t(saved.x_cells) * saved.y_cells;
+	saved.mine = random_plane(random, cells, 6);
+	saved.uncovered = random_plane(random, cells, 1000);
+	saved.flagged = random_plane(random, cells, 2);
+
+	std::string filename = "check.msw";
+	SaveGame loaded;
+	bool ok = saved.write(filename) && loaded.read(filename);
+	remove(filename.c_str());
+	check("save game", ok &&
+		  loaded.x_cells == saved.x_cells &&
+		  loaded.y_cells == saved.y_cells &&
+		  loaded.mines == saved.mines &&
+		  loaded.seed == saved.seed &&
+		  loaded.random == saved.random &&
+		  loaded.state == saved.state &&
+		  loaded.elapsed == saved.elapsed &&
+		  loaded.culprit == saved.culprit &&
+		  loaded.mine == saved.mine &&
+		  loaded.uncovered == saved.uncovered &&
+		  loaded.flagged == saved.flagged);
+
+	// A file cut short must not read.
+	std::vector<Uint8> data;
+	saved.put(data);
+	data.pop_back();
+	Reader in(data.data(), data.size());
+	check("truncated save game", !(loaded.get(in) && in.done()));
+}
+
+// Check if two replay records are the same.
+bool same_record(const ReplayRecord& a, const ReplayRecord& b) {
+	return a.kind == b.kind && a.ticks == b.ticks && a.x_cells == b.x_cells && a.y_cells == b.y_cells &&
+		   a.mines == b.mines && a.seed == b.seed && a.cell == b.cell && a.elapsed == b.elapsed;
+}
+
+// Recorded games read back as they were recorded.
+void check_replay() {
+	Random random(42);
+	std::string filename = "check.rpl";
+	std::vector<ReplayRecord> recorded;
+	{
+		ReplayWriter writer(filename);
+		Uint32 ticks = 0;
+		for (int game = 0; game < 20; game++) {
+			ReplayRecord start;
+			start.ticks = ticks;
+			start.x_cells = 1 + random.below(200);
+			start.y_cells = 9 + random.below(200);
+			start.mines = random.below(start.x_cells * start.y_cells - 8);
+			start.seed = random.next();
+			writer.game(start.x_cells, start.y_cells, start.mines, start.seed, ticks);
+			recorded.push_back(start);
+			Uint32 actions = random.below(500);
+			for (Uint32 i = 0; i < actions; i++) {
+				ReplayRecord action;
+				action.kind = REPLAY_UNCOVER + random.below(3);
+				action.ticks = ticks += random.below(2000);
+				action.cell = random.below(start.x_cells * start.y_cells);
+				writer.action(action.kind, action.cell, ticks);
+				recorded.push_back(action);
+				if (random.below(50) == 0) {
+					writer.flush();
+				}
+			}
+			ReplayRecord result;
+			result.kind = random.below(2) ? REPLAY_WIN : REPLAY_LOSS;
+			result.ticks = ticks += random.below(2000);
+			result.elapsed = random.next();
+			writer.result(result.kind == REPLAY_WIN, result.elapsed, ticks);
+			recorded.push_back(result);
+		}
+		// Wider than any board.
+		writer.game(1 << 23, 9, 0, 1, ticks);
+	}
+
+	std::vector<Uint8> data;
+	bool ok = read_file(filename, data);
+	remove(filename.c_str());
+	size_t header = ok ? ReplayReader::skip_header(data) : 0;
+	ReplayReader reader(data.data() + header, data.size() - header);
+	size_t i = 0;
+	ReplayRecord record;
+	while (ok && reader.next(record)) {
+		ok = i < recorded.size() && same_record(record, recorded[i]);
+		i++;
+	}
+	check("replay", ok && header != 0 && i == recorded.size());
+
+	// A game on a board bigger than the game allows must not read.
+	check("oversized replay game", !reader.is_valid());
+}
+
+// Check if two files have the same bytes.
+bool same_file(std::string a, std::string b) {
+	std::vector<Uint8> data_a;
+	std::vector<Uint8> data_b;
+	return read_file(a, data_a) && read_file(b, data_b) && data_a == data_b;
+}
+
+// Corpus boards read back as they were written, are the boards the game
+// plays from their seeds, and survive a trip through plain text.
+void check_corpus() {
+	// An odd size, so that the boards don't end on a whole byte.
+	int x_cells = 31;
+	int y_cells = 17;
+	int mines = 90;
+	std::string filename = "check.msc";
+	std::vector<CorpusBoard> written;
+	FILE* file = create_corpus(filename, x_cells, y_cells);
+	std::vector<Uint8> out;
+	for (Uint64 seed = 1000; seed < 1100; seed++) {
+		written.push_back(CorpusBoard(x_cells, y_cells, mines));
+		written.back().generate(seed);
+		written.back().put(out);
+	}
+	bool ok = file && fwrite(out.data(), 1, out.size(), file) == out.size() && close_corpus(file, filename);
+
+	// The game plays the same boards.
+	Options options;
+	options.headless = true;
+	Minesweeper game(x_cells, y_cells, mines, options);
+	game.track_minimap = false;
+	bool same_game = true;
+	for (const CorpusBoard& board: written) {
+		game.restart(board.seed);
+		game.act(REPLAY_UNCOVER, size_t(y_cells / 2) * x_cells + x_cells / 2, 0);
+		for (size_t c = 0; c < board.cells(); c++) {
+			same_game = same_game && game.board[c].is_mine() == (board.mine[c] != 0);
+		}
+	}
+	check("corpus boards are the game's", same_game);
+
+	{
+		CorpusReader reader(filename);
+		CorpusBoard board(x_cells, y_cells, 0);
+		size_t i = 0;
+		ok = ok && reader.is_open() && reader.x_cells == x_cells && reader.y_cells == y_cells;
+		while (ok && reader.next_board(board)) {
+			ok = i < written.size() && board.seed == written[i].seed && board.mines == mines && board.mine == written[i].mine;
+			i++;
+		}
+		check("corpus", ok && reader.is_valid() && i == written.size());
+	}
+
+	std::string text = "check.txt";
+	std::string imported = "check2.msc";
+	check("corpus text", export_corpus(filename, text) && import_corpus(text, imported) && same_file(filename, imported));
+	remove(text.c_str());
+	remove(imported.c_str());
+
+	// A file cut short must not read as whole.
+	std::vector<Uint8> data;
+	read_file(filename, data);
+	data.pop_back();
+	write_file(filename, data);
+	{
+		CorpusReader reader(filename);
+		CorpusBoard board(x_cells, y_cells, 0);
+		size_t boards = 0;
+		while (reader.next_board(board)) {
+			boards++;
+		}
+		check("truncated corpus", reader.is_open() && !reader.is_valid() && boards == written.size() - 1);
+	}
+	remove(filename.c_str());
+}
+
+// Check if two modes have the same statistics.
+bool same_stats(ModeStats& a, ModeStats& b) {
+	return a.games == b.games && a.wins == b.wins && a.best == b.best && a.streak == b.streak &&
+		   a.best_streak == b.best_streak && a.percentile(0.5) == b.percentile(0.5) && a.percentile(0.9) == b.percentile(0.9);
+}
+
+// Games added to the statistics read back into the same statistics, and a
+// record cut short is dropped.
+void check_stats() {
+	Random random(48);
+	std::string filename = "check.stats";
+	remove(filename.c_str());
+	int modes[][3] = {{9, 9, 10}, {16, 16, 40}, {30, 16, 99}};
+	ModeStats expected[3];
+	bool ok = true;
+	{
+		StatsStore stats(filename);
+		Uint64 time = 1700000000;
+		for (int i = 0; i < 1000; i++) {
+			int m = random.below(3);
+			GameResult result;
+			result.x_cells = modes[m][0];
+			result.y_cells = modes[m][1];
+			result.mines = modes[m][2];
+			result.won = random.below(3) != 0;
+			result.elapsed = random.below(1000000);
+			result.bbbv = random.below(200);
+			result.clicks = random.below(300);
+			result.seed = random.next();
+			// Games can end out of order, when the clock is set back.
+			result.time = time += Sint64(random.below(1000)) - 100;
+			ok = ok && stats.append(result);
+			expected[m].add(result);
+		}
+	}
+	StatsStore stats(filename);
+	ok = ok && stats.is_valid() && stats.games == 1000;
+	for (int m = 0; m < 3 && ok; m++) {
+		ModeStats* mode = stats.mode(modes[m][0], modes[m][1], modes[m][2]);
+		ok = mode && same_stats(*mode, expected[m]);
+	}
+	check("stats", ok);
+
+	// A record cut short by a crash is cut from the file, and the next game
+	// follows the last whole one.
+	std::vector<Uint8> data;
+	read_file(filename, data);
+	size_t size = data.size();
+	data.push_back(0x80);
+	write_file(filename, data);
+	{
+		StatsStore torn(filename);
+		GameResult result;
+		result.x_cells = 9;
+		result.y_cells = 9;
+		result.mines = 10;
+		ok = torn.games == 1000 && torn.append(result);
+	}
+	StatsStore repaired(filename);
+	read_file(filename, data);
+	// The next record starts with its width, where the torn byte was.
+	check("torn stats", ok && repaired.games == 1001 && data.size() > size && data[size] == 9);
+
+#ifndef _WIN32
+	// A write that fails part way, here at a file size limit, is cut from
+	// the file before the next game, which isn't lost behind it.
+	{
+		StatsStore failing(filename);
+		GameResult result;
+		result.x_cells = 16;
+		result.y_cells = 16;
+		result.mines = 40;
+		result.won = true;
+		result.elapsed = 100;
+		read_file(filename, data);
+		size = data.size();
+		struct rlimit limit;
+		getrlimit(RLIMIT_FSIZE, &limit);
+		struct rlimit small = limit;
+		small.rlim_cur = size + 4;
+		void (*handler)(int) = signal(SIGXFSZ, SIG_IGN);
+		setrlimit(RLIMIT_FSIZE, &small);
+		ok = !failing.append(result);
+		setrlimit(RLIMIT_FSIZE, &limit);
+		signal(SIGXFSZ, handler);
+		read_file(filename, data);
+		ok = ok && data.size() == size + 4 && failing.append(result) && failing.games == 1002;
+	}
+	StatsStore recovered(filename);
+	ModeStats* mode = recovered.mode(16, 16, 40);
+	read_file(filename, data);
+	// The elapsed time follows the width, height, mines and result of the
+	// record where the failed one started.
+	check("failed stats write", ok && recovered.games == 1002 && mode && mode->games == expected[1].games + 1 &&
+		data.size() > size + 4 && data[size + 4] == 100);
+#endif
+	remove(filename.c_str());
+}
+
+// Play random actions on a game in progress, never on a mine once the
+// board is generated.
+void play(Minesweeper& game, Random& random, int actions, Uint32& ticks) {
+	for (int i = 0; i < actions && (game.state == game.GAME_WAITING || game.state == game.GAME_PLAYING); i++) {
+		Sint64 cell = random.below(game.board.size());
+		ticks += 1 + random.below(1000);
+		if (random.below(4) == 0) {
+			game.act(REPLAY_FLAG, cell, ticks);
+		} else if (game.state == game.GAME_WAITING || !game.board[cell].is_mine()) {
+			game.act(REPLAY_UNCOVER, cell, ticks);
+		}
+	}
+}
+
+// Check if two games have the same cells.
+bool same_cells(Minesweeper& a, Minesweeper& b) {
+	if (a.board.size() != b.board.size()) {
+		return false;
+	}
+	for (size_t c = 0; c < a.board.size(); c++) {
+		if (a.board[c].bits != b.board[c].bits) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// A journalled game resumes as it was, whether its journal starts with the
+// game's seed or a snapshot, and a journal cut short resumes up to its last
+// whole action.
+void check_journal() {
+	Random random(49);
+	std::string filename = "check.msj";
+	Options options;
+	options.headless = true;
+	int x_cells = 64;
+	int y_cells = 48;
+	int mines = 500;
+	Minesweeper game(x_cells, y_cells, mines, options);
+	game.track_minimap = false;
+	Minesweeper resumed(x_cells, y_cells, mines, options);
+	resumed.track_minimap = false;
+	Uint32 ticks = 1000;
+
+	for (int snapshot = 0; snapshot < 2; snapshot++) {
+		game.journal.reset(new Journal(filename));
+		game.restart(random.next());
+		play(game, random, 100, ticks);
+		if (snapshot) {
+			// Start the journal over from a snapshot, as it does once the
+			// actions outweigh one.
+			game.journal_game();
+		}
+		for (int i = 0; i < 10; i++) {
+			play(game, random, 20, ticks);
+			game.journal->flush();
+		}
+		game.journal.reset();
+
+		JournalGame journalled;
+		bool ok = journalled.read(filename) && journalled.snapshot == (snapshot != 0) && !journalled.finished &&
+				  resumed.resume(journalled) && resumed.state == game.state && same_cells(game, resumed) &&
+				  resumed.flags == game.flags && resumed.uncovered_cells == game.uncovered_cells;
+		check(snapshot ? "journal from a snapshot" : "journal from a seed", ok);
+	}
+
+	// Cut the journal in the middle of its last action.
+	std::vector<Uint8> data;
+	read_file(filename, data);
+	JournalGame whole;
+	whole.read(filename);
+	data.pop_back();
+	write_file(filename, data);
+	JournalGame torn;
+	check("torn journal", torn.read(filename) && torn.actions.size() + 1 == whole.actions.size());
+	remove(filename.c_str());
+}
+
+// A game on a chunked board file reopens as it was saved, after the first
+// save and after saves that move chunks into freed space.
+void check_chunked_board() {
+	Random random(50);
+	std::string filename = "check.msb";
+	remove(filename.c_str());
+	Options options;
+	options.headless = true;
+	options.board_file = filename;
+	options.chunked = true;
+	// Not a whole number of chunks either way.
+	int x_cells = 700;
+	int y_cells = 300;
+	int mines = 30000;
+	Minesweeper game(x_cells, y_cells, mines, options);
+	game.track_minimap = false;
+	Uint32 ticks = 1000;
+	bool ok = true;
+	for (int save = 0; save < 3 && ok; save++) {
+		play(game, random, 2000, ticks);
+		game.flush_board();
+		Options reopen = options;
+		reopen.chunked = false;
+		Minesweeper opened(1, 1, 0, reopen);
+		ok = opened.x_cells == x_cells && opened.y_cells == y_cells && opened.mines == mines &&
+			 opened.state == game.state && opened.flags == game.flags &&
+			 opened.uncovered_cells == game.uncovered_cells && same_cells(game, opened);
+	}
+	check("chunked board", ok);
+	remove(filename.c_str());
+}
+
+int main() {
+	check_save_game();
+	check_replay();
+	check_corpus();
+	check_stats();
+	check_journal();
+	check_chunked_board();
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Binary encoding helpers for saved games and replays: little-endian
+// integers, varints and bit planes.
+
+// Append a little-endian integer of n bytes.
+inline void put_le(std::vector<Uint8>& out, Uint64 value, int n) {
+	for (int i = 0; i < n; i++) {
+		out.push_back(value >> (i * 8));
+	}
+}
+
+// Append a varint: 7 bits per byte, least significant first, with the top
+// bit set on every byte but the last.
+inline void put_varint(std::vector<Uint8>& out, Uint64 value) {
+	while (value >= 0x80) {
+		out.push_back(value | 0x80);
+		value >>= 7;
+	}
+	out.push_back(value);
+}
+
+// Count the set bits of a word.
+inline int count_bits(Uint64 word) {
+#if defined(__GNUC__)
+	return __builtin_popcountll(word);
+#else
+	word -= (word >> 1) & 0x5555555555555555;
+	word = (word & 0x3333333333333333) + ((word >> 2) & 0x3333333333333333);
+	word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0F;
+	return (word * 0x0101010101010101) >> 56;
+#endif
+}
+
+// Count the zero bits below the lowest set bit of a nonzero word.
+inline int trailing_zeros(Uint64 word) {
+#if defined(__GNUC__)
+	return __builtin_ctzll(word);
+#else
+	return count_bits((word & (0 - word)) - 1);
+#endif
+}
+
+// Map a signed number to an unsigned one, small magnitudes first (0, -1,
+// 1, -2, 2, ...), so that small negative numbers make short varints.
+inline Uint64 zigzag(Sint64 value) {
+	return (Uint64(value) << 1) ^ Uint64(value >> 63);
+}
+
+// Undo zigzag().
+inline Sint64 unzigzag(Uint64 value) {
+	return Sint64(value >> 1) ^ -Sint64(value & 1);
+}
+
+// Reads a buffer. Reading past the end yields zeros and clears ok, so a
+// whole record can be read before checking for truncation.
+struct Reader {
+	const Uint8* data;
+	const Uint8* end;
+	bool ok = true;
+
+	Reader(const Uint8* data, size_t size): data(data), end(data + size) {}
+
+	// Read a little-endian integer of n bytes.
+	Uint64 le(int n) {
+		if (end - data < n) {
+			ok = false;
+			data = end;
+			return 0;
+		}
+		Uint64 value = 0;
+		for (int i = 0; i < n; i++) {
+			value |= Uint64(data[i]) << (i * 8);
+		}
+		data += n;
+		return value;
+	}
+
+	// Read a varint.
+	Uint64 varint() {
+		Uint64 value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (data == end) {
+				ok = false;
+				return 0;
+			}
+			Uint8 byte = *data++;
+			value |= Uint64(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) {
+				return value;
+			}
+		}
+		ok = false;
+		return 0;
+	}
+
+	// Skip n bytes, returning where they start.
+	const Uint8* skip(size_t n) {
+		if (size_t(end - data) < n) {
+			ok = false;
+			data = end;
+			return NULL;
+		}
+		const Uint8* start = data;
+		data += n;
+		return start;
+	}
+
+	// Check if everything has been read.
+	bool done() {
+		return ok && data == end;
+	}
+};
+
+// A bit plane holds one bit per element, 64 to a word, least significant
+// bit first.
+typedef std::vector<Uint64> BitPlane;
+
+// Collect one bit per byte of n bytes, set if the byte has any bit of a
+// mask set.
+inline BitPlane pack_plane(const Uint8* bytes, size_t n, Uint8 mask) {
+	BitPlane plane((n + 63) / 64, 0);
+	size_t i = 0;
+#ifdef __SSE2__
+	// Test 16 bytes at a time and gather the results with a byte movemask.
+	__m128i m = _mm_set1_epi8(mask);
+	__m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i*)(bytes + i)), m);
+		Uint64 bits = ~_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) & 0xFFFF;
+		plane[i / 64] |= bits << (i % 64);
+	}
+#endif
+	for (; i < n; i++) {
+		if (bytes[i] & mask) {
+			plane[i / 64] |= Uint64(1) << (i % 64);
+		}
+	}
+	return plane;
+}
+
+// Set a mask on each of n bytes whose bit is set in a plane.
+inline void unpack_plane(const BitPlane& plane, Uint8* bytes, size_t n, Uint8 mask) {
+	size_t i = 0;
+#ifdef __SSE2__
+	// Spread 16 bits over 16 bytes and select each byte's own bit.
+	__m128i m = _mm_set1_epi8(mask);
+	__m128i select = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+	for (; i + 16 <= n; i += 16) {
+		Uint32 bits = (plane[i / 64] >> (i % 64)) & 0xFFFF;
+		if (!bits) {
+			continue;
+		}
+		__m128i spread = _mm_unpacklo_epi64(_mm_set1_epi8(bits & 0xFF), _mm_set1_epi8(bits >> 8));
+		__m128i set = _mm_cmpeq_epi8(_mm_and_si128(spread, select), select);
+		__m128i v = _mm_loadu_si128((const __m128i*)(bytes + i));
+		_mm_storeu_si128((__m128i*)(bytes + i), _mm_or_si128(v, _mm_and_si128(set, m)));
+	}
+#endif
+	for (; i < n; i++) {
+		if ((plane[i / 64] >> (i % 64)) & 1) {
+			bytes[i] |= mask;
+		}
+	}
+}
+
+// Count the bits equal to a value from bit i of a plane of n bits.
+inline size_t plane_run(const BitPlane& plane, size_t i, size_t n, bool value) {
+	size_t start = i;
+	while (i < n) {
+		Uint64 word = value ? ~plane[i / 64] : plane[i / 64];
+		word >>= i % 64;
+		if (word) {
+			i += trailing_zeros(word);
+			break;
+		}
+		i += 64 - i % 64;
+	}
+	return std::min(i, n) - start;
+}
+
+// Set bits i to i + length of a plane.
+inline void fill_plane(BitPlane& plane, size_t i, size_t length) {
+	size_t end = i + length;
+	while (i < end) {
+		size_t bits = std::min(end - i, 64 - i % 64);
+		Uint64 mask = bits == 64 ? ~Uint64(0) : ((Uint64(1) << bits) - 1) << (i % 64);
+		plane[i / 64] |= mask;
+		i += bits;
+	}
+}
+
+// Count the places where a plane changes from one bit to the next.
+inline size_t plane_transitions(const BitPlane& plane) {
+	size_t transitions = 0;
+	Uint64 carry = 0;
+	for (Uint64 word: plane) {
+		transitions += count_bits(word ^ ((word << 1) | carry));
+		carry = word >> 63;
+	}
+	return transitions;
+}
+
+// Count the set bits of a plane.
+inline size_t plane_count(const BitPlane& plane) {
+	size_t count = 0;
+	for (Uint64 word: plane) {
+		count += count_bits(word);
+	}
+	return count;
+}
+
+// Ways of storing a plane.
+enum {
+	PLANE_RAW,
+	PLANE_RUNS
+};
+
+// Append a plane of n bits, either as raw bits or as the varint lengths of
+// its alternating runs of zeros and ones (starting with zeros), whichever is
+// smaller. Either way the encoding is prefixed with its way and length.
+inline void put_plane(std::vector<Uint8>& out, const BitPlane& plane, size_t n) {
+	// Every run takes at least a byte, so planes with as many runs as raw
+	// bytes are stored raw without trying runs.
+	std::vector<Uint8> runs;
+	size_t raw_size = (n + 7) / 8;
+	bool value = false;
+	if (plane_transitions(plane) + 1 < raw_size) {
+		for (size_t i = 0; i < n && runs.size() < raw_size; value = !value) {
+			size_t run = plane_run(plane, i, n, value);
+			put_varint(runs, run);
+			i += run;
+		}
+	}
+	if (!runs.empty() && runs.size() < raw_size) {
+		out.push_back(PLANE_RUNS);
+		put_varint(out, runs.size());
+		out.insert(out.end(), runs.begin(), runs.end());
+	} else {
+		out.push_back(PLANE_RAW);
+		put_varint(out, raw_size);
+		size_t start = out.size();
+		out.resize(start + raw_size);
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+		memcpy(out.data() + start, plane.data(), raw_size);
+#else
+		for (size_t i = 0; i < raw_size; i++) {
+			out[start + i] = plane[i / 8] >> (i % 8 * 8);
+		}
+#endif
+	}
+}
+
+// Read a plane of n bits written by put_plane(). Returns false if the
+// encoding is invalid.
+inline bool get_plane(Reader& in, BitPlane& plane, size_t n) {
+	plane.assign((n + 63) / 64, 0);
+	Uint8 way = in.le(1);
+	size_t size = in.varint();
+	const Uint8* data = in.skip(size);
+	if (!in.ok) {
+		return false;
+	}
+	if (way == PLANE_RAW) {
+		if (size != (n + 7) / 8) {
+			return false;
+		}
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+		memcpy(plane.data(), data, size);
+#else
+		for (size_t i = 0; i < size; i++) {
+			plane[i / 8] |= Uint64(data[i]) << (i % 8 * 8);
+		}
+#endif
+		// Clear the padding bits.
+		if (n % 64) {
+			plane.back() &= (Uint64(1) << (n % 64)) - 1;
+		}
+		return true;
+	} else if (way == PLANE_RUNS) {
+		Reader runs(data, size);
+		size_t i = 0;
+		bool value = false;
+		while (!runs.done()) {
+			Uint64 run = runs.varint();
+			if (!runs.ok || run > n - i) {
+				return false;
+			}
+			if (value) {
+				fill_plane(plane, i, run);
+			}
+			i += run;
+			value = !value;
+		}
+		return i == n;
+	}
+	return false;
+}
+
+// Read a whole file. Returns false if it can't be read.
+inline bool read_file(std::string filename, std::vector<Uint8>& data) {
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	bool ok = size >= 0;
+	data.resize(ok ? size : 0);
+	if (ok && size > 0) {
+		ok = fread(data.data(), 1, size, file) == size_t(size);
+	}
+	fclose(file);
+	return ok;
+}
+
+// Write a whole file. Returns false if it can't be written.
+inline bool write_file(std::string filename, const std::vector<Uint8>& data) {
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	if (!data.empty()) {
+		fwrite(data.data(), 1, data.size(), file);
+	}
+	bool ok = !ferror(file);
+	ok = fclose(file) == 0 && ok;
+	return ok;
+}
\ No newline at end of file
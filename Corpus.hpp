@@ -0,0 +1,685 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <future>
+#include <algorithm>
+
+// Board corpora. A corpus file starts with the magic "MSWPCORP", a version
+// and the width and height of its boards, all little-endian, followed by
+// boards of a fixed size, so that any board can be found without reading
+// the ones before it. Each board is its 64-bit seed (all ones for a board
+// without one, such as an imported one) followed by its mines as a raw bit
+// plane, one bit per cell in row-major order.
+//
+// Generated boards are the boards the game plays from their seeds when the
+// first click is in the center: game.restart(seed) followed by
+// game.uncover(x_cells / 2, y_cells / 2).
+
+// A board of a corpus, with a byte per cell for its mines and another for
+// its neighbouring mine counts.
+struct CorpusBoard {
+	static const Uint32 VERSION = 1;
+	static const Uint64 NO_SEED = ~Uint64(0);
+
+	int x_cells;
+	int y_cells;
+	int mines;
+	Uint64 seed = NO_SEED;
+	std::vector<Uint8> mine;
+	std::vector<Uint8> neighbours;
+
+	// Scratch space of the filters.
+	std::vector<Uint8> state;
+	std::vector<size_t> stack;
+
+	// Default constructor.
+	CorpusBoard(int x_cells, int y_cells, int mines):
+		x_cells(x_cells),
+		y_cells(y_cells),
+		mines(mines),
+		mine(size_t(x_cells) * y_cells),
+		neighbours(size_t(x_cells) * y_cells) {}
+
+	// The number of cells.
+	size_t cells() const {
+		return mine.size();
+	}
+
+	// The size of a board in a corpus file.
+	size_t record_size() const {
+		return 8 + (cells() + 7) / 8;
+	}
+
+	// Generate the board of a seed. This must draw the same random numbers as
+	// Minesweeper::generate_board() and Minesweeper::divert().
+	void generate(Uint64 seed) {
+		this->seed = seed;
+		Random random(seed);
+		std::fill(mine.begin(), mine.end(), 0);
+		for (int i = 0; i < mines; i++) {
+			while (1) {
+				int x = random.below(x_cells);
+				int y = random.below(y_cells);
+				Uint8& cell = mine[size_t(y) * x_cells + x];
+				if (!cell) {
+					cell = 1;
+					break;
+				}
+			}
+		}
+		// Divert mines away from the first click.
+		int x = x_cells / 2;
+		int y = y_cells / 2;
+		for (int j = y - 1; j <= y + 1; j++) {
+			for (int i = x - 1; i <= x + 1; i++) {
+				if (i < 0 || i >= x_cells || j < 0 || j >= y_cells || !mine[size_t(j) * x_cells + i]) {
+					continue;
+				}
+				while (1) {
+					int n = random.below(x_cells);
+					int m = random.below(y_cells);
+					Uint8& cell = mine[size_t(m) * x_cells + n];
+					if (cell || (n >= x - 1 && n <= x + 1 && m >= y - 1 && m <= y + 1)) {
+						continue;
+					}
+					cell = 1;
+					break;
+				}
+				mine[size_t(j) * x_cells + i] = 0;
+			}
+		}
+	}
+
+	// Calculate the neighbouring mine count of each cell.
+	void count_neighbours() {
+		for (int y = 0; y < y_cells; y++) {
+			int y0 = std::max(y - 1, 0);
+			int y1 = std::min(y + 1, y_cells - 1);
+			for (int x = 0; x < x_cells; x++) {
+				int x0 = std::max(x - 1, 0);
+				int x1 = std::min(x + 1, x_cells - 1);
+				int count = 0;
+				for (int j = y0; j <= y1; j++) {
+					const Uint8* row = &mine[size_t(j) * x_cells];
+					for (int i = x0; i <= x1; i++) {
+						count += row[i];
+					}
+				}
+				neighbours[size_t(y) * x_cells + x] = count;
+			}
+		}
+	}
+
+	// Push the cells around a cell (not itself) to the stack.
+	void push_around(int c) {
+		int x = c % x_cells;
+		int y = c / x_cells;
+		for (int j = std::max(y - 1, 0); j <= std::min(y + 1, y_cells - 1); j++) {
+			for (int i = std::max(x - 1, 0); i <= std::min(x + 1, x_cells - 1); i++) {
+				if (i != x || j != y) {
+					stack.push_back(j * x_cells + i);
+				}
+			}
+		}
+	}
+
+	// The board's 3BV (see count_3bv()). The neighbouring mine counts must be
+	// up to date.
+	int bbbv() {
+		return count_3bv(x_cells, y_cells,
+			[&](size_t c) { return mine[c]; },
+			[&](size_t c) { return neighbours[c]; },
+			state, stack);
+	}
+
+	// Check if the board can be cleared from the first click in its center
+	// without guessing, using the two classic rules: a number whose mines are
+	// all flagged clears its other cells, and a number with as many covered
+	// cells as unflagged mines flags them all; and the same for the cells
+	// one number's covered cells leave over from another's that contain them.
+	// The neighbouring mine counts must be up to date.
+	bool no_guess() {
+		enum {
+			COVERED,
+			OPEN,
+			FLAGGED
+		};
+		state.assign(cells(), COVERED);
+		size_t safe = cells() - std::count(mine.begin(), mine.end(), 1);
+		size_t opened = 0;
+
+		// Open a safe cell and the opening around it.
+		auto open = [&](int c) {
+			stack.assign(1, c);
+			while (!stack.empty()) {
+				int d = stack.back();
+				stack.pop_back();
+				if (state[d] != COVERED) {
+					continue;
+				}
+				state[d] = OPEN;
+				opened++;
+				if (!neighbours[d]) {
+					push_around(d);
+				}
+			}
+		};
+
+		// Find the covered cells around an open cell, and the mines left
+		// among them.
+		auto covered = [&](int c, int* around, int& count) {
+			int x = c % x_cells;
+			int y = c / x_cells;
+			int left = neighbours[c];
+			count = 0;
+			for (int j = std::max(y - 1, 0); j <= std::min(y + 1, y_cells - 1); j++) {
+				for (int i = std::max(x - 1, 0); i <= std::min(x + 1, x_cells - 1); i++) {
+					int d = j * x_cells + i;
+					if (state[d] == FLAGGED) {
+						left--;
+					} else if (state[d] == COVERED) {
+						around[count++] = d;
+					}
+				}
+			}
+			return left;
+		};
+
+		int center = y_cells / 2 * x_cells + x_cells / 2;
+		if (mine[center]) {
+			return false;
+		}
+		open(center);
+		bool progress = true;
+		while (progress && opened < safe) {
+			progress = false;
+			int a[8];
+			int b[8];
+			int na;
+			int nb;
+			// The rules of single numbers.
+			for (int c = 0; c < int(cells()); c++) {
+				if (state[c] != OPEN || !neighbours[c]) {
+					continue;
+				}
+				int left = covered(c, a, na);
+				if (!na || (left && left != na)) {
+					continue;
+				}
+				for (int k = 0; k < na; k++) {
+					if (left) {
+						state[a[k]] = FLAGGED;
+					} else {
+						open(a[k]);
+					}
+				}
+				progress = true;
+			}
+			if (progress) {
+				continue;
+			}
+			// The rules of pairs of numbers, one's covered cells containing
+			// the other's.
+			for (int c = 0; c < int(cells()) && !progress; c++) {
+				if (state[c] != OPEN || !neighbours[c]) {
+					continue;
+				}
+				int left_a = covered(c, a, na);
+				if (!na) {
+					continue;
+				}
+				int x = c % x_cells;
+				int y = c / x_cells;
+				for (int j = std::max(y - 2, 0); j <= std::min(y + 2, y_cells - 1) && !progress; j++) {
+					for (int i = std::max(x - 2, 0); i <= std::min(x + 2, x_cells - 1) && !progress; i++) {
+						int d = j * x_cells + i;
+						if (d == c || state[d] != OPEN || !neighbours[d]) {
+							continue;
+						}
+						int left_b = covered(d, b, nb);
+						if (nb <= na || !std::all_of(a, a + na, [&](int e) { return std::find(b, b + nb, e) != b + nb; })) {
+							continue;
+						}
+						// The cells of b outside a hold the mines b has left
+						// over a.
+						int left = left_b - left_a;
+						if (left && left != nb - na) {
+							continue;
+						}
+						for (int k = 0; k < nb; k++) {
+							if (std::find(a, a + na, b[k]) != a + na) {
+								continue;
+							}
+							if (left) {
+								state[b[k]] = FLAGGED;
+							} else {
+								open(b[k]);
+							}
+						}
+						progress = true;
+					}
+				}
+			}
+		}
+		return opened == safe;
+	}
+
+	// Append the board to a corpus.
+	void put(std::vector<Uint8>& out) const {
+		put_le(out, seed, 8);
+		BitPlane plane = pack_plane(mine.data(), cells(), 1);
+		size_t start = out.size();
+		size_t size = (cells() + 7) / 8;
+		out.resize(start + size);
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+		memcpy(&out[start], plane.data(), size);
+#else
+		for (size_t i = 0; i < size; i++) {
+			out[start + i] = plane[i / 8] >> (i % 8 * 8);
+		}
+#endif
+	}
+
+	// Read the board from a record of a corpus, counting its mines.
+	void get(const Uint8* record) {
+		Reader in(record, 8);
+		seed = in.le(8);
+		BitPlane plane((cells() + 63) / 64, 0);
+		size_t size = (cells() + 7) / 8;
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+		memcpy(plane.data(), record + 8, size);
+#else
+		for (size_t i = 0; i < size; i++) {
+			plane[i / 8] |= Uint64(record[8 + i]) << (i % 8 * 8);
+		}
+#endif
+		// Ignore the padding bits.
+		if (cells() % 64) {
+			plane.back() &= (Uint64(1) << (cells() % 64)) - 1;
+		}
+		std::fill(mine.begin(), mine.end(), 0);
+		unpack_plane(plane, mine.data(), cells(), 1);
+		mines = plane_count(plane);
+	}
+};
+
+// Write the header of a corpus file. Returns NULL if it can't be created.
+inline FILE* create_corpus(std::string filename, int x_cells, int y_cells) {
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (!file) {
+		fprintf(stderr, "Could not write \"%s\".\n", filename.c_str());
+		return NULL;
+	}
+	std::vector<Uint8> header;
+	const char* magic = "MSWPCORP";
+	header.insert(header.end(), magic, magic + 8);
+	put_le(header, CorpusBoard::VERSION, 4);
+	put_le(header, x_cells, 4);
+	put_le(header, y_cells, 4);
+	fwrite(header.data(), 1, header.size(), file);
+	return file;
+}
+
+// Close a file, reporting any error. Returns false if there was one.
+inline bool close_corpus(FILE* file, std::string filename) {
+	bool ok = !ferror(file);
+	ok = fclose(file) == 0 && ok;
+	if (!ok) {
+		fprintf(stderr, "Could not write \"%s\".\n", filename.c_str());
+	}
+	return ok;
+}
+
+// Generate the boards of options.corpus_seeds seeds from options.seed on to
+// options.corpus_file, keeping the ones that pass the 3BV and no-guess
+// filters, in the order of their seeds. The seeds are split into batches
+// that every thread of the pool takes a part of, and each batch is written
+// to the file while the next one is generated, so memory use doesn't grow
+// with the number of boards.
+bool generate_corpus(int x_cells, int y_cells, int mines, Options options) {
+	ThreadPool pool(options.threads);
+	int threads = pool.size();
+	FILE* file = create_corpus(options.corpus_file, x_cells, y_cells);
+	if (!file) {
+		return false;
+	}
+
+	// The seeds of a batch, and the boards each thread kept of a batch, two
+	// batches of them so that one can be written while the other is filled.
+	const Uint64 BATCH = 1 << 16;
+	std::vector<std::vector<Uint8>> kept[2];
+	kept[0].resize(threads);
+	kept[1].resize(threads);
+	std::vector<CorpusBoard> boards(threads, CorpusBoard(x_cells, y_cells, mines));
+	std::vector<Uint64> counts(threads, 0);
+	bool filter = options.min_3bv > 0 || options.max_3bv < INT_MAX || options.no_guess;
+	std::future<void> written;
+
+	Uint64 start_ticks = SDL_GetPerformanceCounter();
+	for (Uint64 first = 0, b = 0; first < options.corpus_seeds; first += BATCH, b ^= 1) {
+		Uint64 n = std::min(BATCH, options.corpus_seeds - first);
+		std::vector<std::vector<Uint8>>& out = kept[b];
+		pool.run(threads, [&](int t) {
+			CorpusBoard& board = boards[t];
+			out[t].clear();
+			for (Uint64 s = first + n * t / threads; s < first + n * (t + 1) / threads; s++) {
+				board.generate(options.seed + s);
+				if (filter) {
+					board.count_neighbours();
+					int clicks = board.bbbv();
+					if (clicks < options.min_3bv || clicks > options.max_3bv || (options.no_guess && !board.no_guess())) {
+						continue;
+					}
+				}
+				board.put(out[t]);
+				counts[t]++;
+			}
+		});
+		if (written.valid()) {
+			written.wait();
+		}
+		written = std::async(std::launch::async, [file, &out] {
+			for (const std::vector<Uint8>& part: out) {
+				fwrite(part.data(), 1, part.size(), file);
+			}
+		});
+	}
+	if (written.valid()) {
+		written.wait();
+	}
+	if (!close_corpus(file, options.corpus_file)) {
+		return false;
+	}
+
+	Uint64 count = 0;
+	for (Uint64 c: counts) {
+		count += c;
+	}
+	double seconds = double(SDL_GetPerformanceCounter() - start_ticks) / SDL_GetPerformanceFrequency();
+	printf("Generated %llu boards of %llu seeds in %.2f seconds (%.0f seeds per second, %d threads)\n",
+		(unsigned long long)count, (unsigned long long)options.corpus_seeds, seconds, options.corpus_seeds / seconds, threads);
+	return true;
+}
+
+// Reads a corpus file a block of boards at a time.
+class CorpusReader {
+private:
+	FILE* file = NULL;
+	std::vector<Uint8> block;
+	size_t next = 0;
+	size_t record_size = 0;
+
+public:
+	int x_cells = 0;
+	int y_cells = 0;
+
+	// Default constructor. Check is_open() to see if the file is a corpus of
+	// this version.
+	CorpusReader(std::string filename) {
+		file = fopen(filename.c_str(), "rb");
+		if (!file) {
+			return;
+		}
+		Uint8 header[20];
+		Reader in(header, fread(header, 1, sizeof(header), file));
+		const Uint8* magic = in.skip(8);
+		bool valid = magic && memcmp(magic, "MSWPCORP", 8) == 0 && in.le(4) == CorpusBoard::VERSION;
+		x_cells = in.le(4);
+		y_cells = in.le(4);
+		if (!valid || !in.ok || x_cells <= 0 || y_cells <= 0 || x_cells > SaveGame::MAX_SIDE || y_cells > SaveGame::MAX_SIDE) {
+			fclose(file);
+			file = NULL;
+			return;
+		}
+		record_size = 8 + (size_t(x_cells) * y_cells + 7) / 8;
+	}
+
+	// Destructor.
+	~CorpusReader() {
+		if (file) {
+			fclose(file);
+		}
+	}
+
+	CorpusReader(const CorpusReader&) = delete;
+	CorpusReader& operator=(const CorpusReader&) = delete;
+
+	// Check if the file is open.
+	bool is_open() {
+		return file != NULL;
+	}
+
+	// Read the next board. Returns false at the end of the file, or at a
+	// truncated board, which is_valid() tells apart.
+	bool next_board(CorpusBoard& board) {
+		if (next == block.size()) {
+			block.resize(std::max(size_t(1), (1 << 20) / record_size) * record_size);
+			block.resize(fread(block.data(), 1, block.size(), file));
+			next = 0;
+		}
+		if (block.size() - next < record_size) {
+			return false;
+		}
+		board.get(&block[next]);
+		next += record_size;
+		return true;
+	}
+
+	// Check if the file ended at a whole board.
+	bool is_valid() {
+		return next == block.size() && feof(file) && !ferror(file);
+	}
+};
+
+// Reads plain-text boards a line at a time. Each board is a row of
+// characters per row of cells, with '*', 'x', 'X' or 'M' for a mine and any
+// other character for a cell without one, such as '.', '-', 'o' or the
+// digits of a solved board. Boards are separated by blank lines, and lines
+// starting with '#' are comments, except that "# seed N" gives the seed of
+// the next board.
+class TextBoardReader {
+private:
+	FILE* file;
+	std::vector<char> buffer;
+	size_t begin = 0;
+	size_t end = 0;
+	bool eof = false;
+
+	// Read the next line, without its line break, into a view of the
+	// buffer. Returns false at the end of the file.
+	bool line(const char*& text, size_t& length) {
+		while (1) {
+			const char* found = (const char*)memchr(buffer.data() + begin, '\n', end - begin);
+			if (found || (eof && begin < end)) {
+				text = buffer.data() + begin;
+				length = (found ? found - text : end - begin);
+				begin += length + (found ? 1 : 0);
+				if (length && text[length - 1] == '\r') {
+					length--;
+				}
+				lines++;
+				return true;
+			}
+			if (eof) {
+				return false;
+			}
+			// Keep the partial line, and make room for more.
+			memmove(buffer.data(), buffer.data() + begin, end - begin);
+			end -= begin;
+			begin = 0;
+			if (end == buffer.size()) {
+				buffer.resize(buffer.size() * 2);
+			}
+			size_t got = fread(buffer.data() + end, 1, buffer.size() - end, file);
+			end += got;
+			eof = got == 0;
+		}
+	}
+
+public:
+	// The number of lines read.
+	Uint64 lines = 0;
+
+	// Default constructor.
+	TextBoardReader(FILE* file): file(file), buffer(1 << 20) {}
+
+	// Read the next board, which must have the size of the board unless it
+	// has no cells yet. Returns false at the end of the file; error is set
+	// if the board is malformed.
+	bool next_board(std::vector<Uint8>& mine, int& x_cells, int& y_cells, Uint64& seed, bool& error) {
+		mine.clear();
+		seed = CorpusBoard::NO_SEED;
+		int rows = 0;
+		const char* text;
+		size_t length;
+		while (line(text, length)) {
+			if (length && text[0] == '#') {
+				static const char prefix[] = "# seed ";
+				size_t n = sizeof(prefix) - 1;
+				if (length > n && length < n + 21 && memcmp(text, prefix, n) == 0) {
+					seed = strtoull(std::string(text + n, length - n).c_str(), NULL, 10);
+				}
+				continue;
+			}
+			if (!length) {
+				if (rows) {
+					break;
+				}
+				continue;
+			}
+			if (!rows && !x_cells) {
+				x_cells = length;
+			}
+			if (int(length) != x_cells) {
+				error = true;
+				return false;
+			}
+			size_t start = mine.size();
+			mine.resize(start + length);
+			Uint8* row = &mine[start];
+			for (size_t i = 0; i < length; i++) {
+				char c = text[i];
+				row[i] = c == '*' || c == 'x' || c == 'X' || c == 'M';
+			}
+			rows++;
+		}
+		if (!rows) {
+			return false;
+		}
+		if (!y_cells) {
+			y_cells = rows;
+		}
+		if (rows != y_cells) {
+			error = true;
+			return false;
+		}
+		return true;
+	}
+};
+
+// Convert plain-text boards (see TextBoardReader) to a corpus file. Every
+// board must have the size of the first. The text is read in blocks, so the
+// boards are never all in memory.
+bool import_corpus(std::string text_file, std::string filename) {
+	FILE* text = fopen(text_file.c_str(), "rb");
+	if (!text) {
+		fprintf(stderr, "Could not read \"%s\".\n", text_file.c_str());
+		return false;
+	}
+	Uint64 start_ticks = SDL_GetPerformanceCounter();
+	TextBoardReader reader(text);
+	CorpusBoard board(0, 0, 0);
+	std::vector<Uint8> out;
+	int x_cells = 0;
+	int y_cells = 0;
+	bool error = false;
+	Uint64 count = 0;
+	FILE* file = NULL;
+	while (reader.next_board(board.mine, x_cells, y_cells, board.seed, error)) {
+		if (!file) {
+			if (x_cells > SaveGame::MAX_SIDE || y_cells > SaveGame::MAX_SIDE) {
+				break;
+			}
+			file = create_corpus(filename, x_cells, y_cells);
+			if (!file) {
+				fclose(text);
+				return false;
+			}
+		}
+		board.put(out);
+		count++;
+		if (out.size() >= 1 << 20) {
+			fwrite(out.data(), 1, out.size(), file);
+			out.clear();
+		}
+	}
+	fclose(text);
+	if (error || x_cells > SaveGame::MAX_SIDE || y_cells > SaveGame::MAX_SIDE) {
+		fprintf(stderr, "\"%s\" has a malformed board at line %llu.\n", text_file.c_str(), (unsigned long long)reader.lines);
+	} else if (!file) {
+		fprintf(stderr, "\"%s\" has no boards.\n", text_file.c_str());
+	}
+	if (!file) {
+		return false;
+	}
+	fwrite(out.data(), 1, out.size(), file);
+	if (!close_corpus(file, filename) || error) {
+		return false;
+	}
+	double seconds = double(SDL_GetPerformanceCounter() - start_ticks) / SDL_GetPerformanceFrequency();
+	printf("Imported %llu %dx%d boards in %.2f seconds (%.0f per second)\n", (unsigned long long)count, x_cells, y_cells, seconds, count / seconds);
+	return true;
+}
+
+// Convert a corpus file to plain-text boards, with '*' for mines and '.'
+// for other cells, each preceded by its seed if it has one.
+bool export_corpus(std::string filename, std::string text_file) {
+	CorpusReader reader(filename);
+	if (!reader.is_open()) {
+		fprintf(stderr, "\"%s\" is not a valid corpus.\n", filename.c_str());
+		return false;
+	}
+	FILE* text = fopen(text_file.c_str(), "wb");
+	if (!text) {
+		fprintf(stderr, "Could not write \"%s\".\n", text_file.c_str());
+		return false;
+	}
+	Uint64 start_ticks = SDL_GetPerformanceCounter();
+	CorpusBoard board(reader.x_cells, reader.y_cells, 0);
+	std::vector<char> out;
+	Uint64 count = 0;
+	while (reader.next_board(board)) {
+		if (board.seed != CorpusBoard::NO_SEED) {
+			char line[32];
+			int length = snprintf(line, sizeof(line), "# seed %llu\n", (unsigned long long)board.seed);
+			out.insert(out.end(), line, line + length);
+		}
+		for (int y = 0; y < board.y_cells; y++) {
+			const Uint8* row = &board.mine[size_t(y) * board.x_cells];
+			for (int x = 0; x < board.x_cells; x++) {
+				out.push_back(row[x] ? '*' : '.');
+			}
+			out.push_back('\n');
+		}
+		out.push_back('\n');
+		count++;
+		if (out.size() >= 1 << 20) {
+			fwrite(out.data(), 1, out.size(), text);
+			out.clear();
+		}
+	}
+	fwrite(out.data(), 1, out.size(), text);
+	bool valid = reader.is_valid();
+	if (!valid) {
+		fprintf(stderr, "\"%s\" is truncated after %llu boards.\n", filename.c_str(), (unsigned long long)count);
+	}
+	if (!close_corpus(text, text_file) || !valid) {
+		return false;
+	}
+	double seconds = double(SDL_GetPerformanceCounter() - start_ticks) / SDL_GetPerformanceFrequency();
+	printf("Exported %llu %dx%d boards in %.2f seconds (%.0f per second)\n", (unsigned long long)count, reader.x_cells, reader.y_cells, seconds, count / seconds);
+	return true;
+}
\ No newline at end of file
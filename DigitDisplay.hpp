@@ -0,0 +1,112 @@
+#include <vector>
+#include <algorithm>
+
+// A number shown in digit sprites inside a frame, like the flag counter and
+// the timer. The display is rendered into its own pixels only when its
+// number changes, and can be blitted as a single sprite. The frame sprite is
+// made for three digits, so it is stretched by repeating its middle.
+class DigitDisplay {
+private:
+	// The rendered display, and its palette indices if the sprites have them.
+	std::vector<Uint32> pixels;
+	std::vector<Uint8> indices;
+	int x_res = 0;
+	int y_res = 0;
+
+	// The sprites the display is rendered from.
+	Sprite frame;
+	const Sprite* digit_sprites = nullptr;
+
+	// The number of digits, the margin between the frame and the digits, and
+	// the number shown.
+	int digits = 0;
+	int margin_x = 0;
+	int margin_y = 0;
+	int value = -1;
+
+	// Copy columns sx to sx + w of a sprite to a point of the display.
+	void blit(const Sprite& sprite, int sx, int w, int x, int y) {
+		for (int j = 0; j < sprite.y_res; j++) {
+			int from = j * sprite.x_res + sx;
+			int to = (y + j) * x_res + x;
+			std::copy(sprite.data + from, sprite.data + from + w, pixels.begin() + to);
+			if (sprite.indices) {
+				std::copy(sprite.indices + from, sprite.indices + from + w, indices.begin() + to);
+			}
+		}
+	}
+
+public:
+	// Null constructor.
+	DigitDisplay() {}
+
+	// Default constructor. The digit sprites are the ten sprites of 0 to 9,
+	// which must stay valid.
+	DigitDisplay(int digits, const Sprite& frame, const Sprite* digit_sprites) {
+		this->frame = frame;
+		this->digit_sprites = digit_sprites;
+		this->digits = digits;
+		int digit_x_res = digit_sprites[0].x_res;
+		margin_x = (frame.x_res - 3 * digit_x_res) / 2;
+		margin_y = (frame.y_res - digit_sprites[0].y_res) / 2;
+		x_res = margin_x * 2 + digits * digit_x_res;
+		y_res = frame.y_res;
+		pixels.resize(x_res * y_res);
+		if (frame.indices) {
+			indices.resize(x_res * y_res);
+		}
+
+		// Stretch the frame, one digit's width at a time.
+		blit(frame, 0, margin_x, 0, 0);
+		for (int i = 0; i < digits; i++) {
+			blit(frame, margin_x, digit_x_res, margin_x + i * digit_x_res, 0);
+		}
+		blit(frame, frame.x_res - margin_x, margin_x, x_res - margin_x, 0);
+	}
+
+	// The largest number that can be shown.
+	int max() {
+		int max = 1;
+		for (int i = 0; i < digits; i++) {
+			max *= 10;
+		}
+		return max - 1;
+	}
+
+	// Show a number, clamped to what fits. Returns true if the display
+	// changed.
+	bool set(int value) {
+		value = std::max(0, std::min(value, max()));
+		if (value == this->value) {
+			return false;
+		}
+		this->value = value;
+		// Render the digits from right to left.
+		int digit_x_res = digit_sprites[0].x_res;
+		for (int i = digits - 1; i >= 0; i--) {
+			const Sprite& digit = digit_sprites[value % 10];
+			blit(digit, 0, digit_x_res, margin_x + i * digit_x_res, margin_y);
+			value /= 10;
+		}
+		return true;
+	}
+
+	// The rendered display.
+	Sprite sprite() {
+		Sprite sprite(pixels.data(), x_res, y_res);
+		if (!indices.empty()) {
+			sprite.indices = indices.data();
+		}
+		return sprite;
+	}
+
+	// The number of digits needed to show a number.
+	static int digits_of(int value) {
+		int digits = 1;
+		while (value >= 10) {
+			value /= 10;
+			digits++;
+		}
+		return digits;
+	}
+};
\ No newline at end of file
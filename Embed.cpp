@@ -0,0 +1,53 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+#include <string>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+// Convert sprite sheets to a header of ready-to-blit ARGB8888 arrays, so
+// that they can be built into the executable. Each sheet is named after its
+// file, so "Border.png" becomes border_png.
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <sheet.png>... > Sheets.hpp\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	printf("// Generated from the sprite sheets by Embed.cpp. Do not edit.\n");
+	for (int i = 1; i < argc; i++) {
+		// Load the sprite sheet.
+		int x_res;
+		int y_res;
+		int channels;
+		unsigned char* raw_data = stbi_load(argv[i], &x_res, &y_res, &channels, 3);
+		if (!raw_data) {
+			fprintf(stderr, "Could not load sprite \"%s\".\n", argv[i]);
+			exit(EXIT_FAILURE);
+		}
+
+		// Name the sheet after its file.
+		std::string name = argv[i];
+		name = name.substr(name.find_last_of("/\\") + 1);
+		for (char& c: name) {
+			c = isalnum(c) ? tolower(c) : '_';
+		}
+
+		// Write the pixels in the same format as Sprite::data.
+		printf("\n// %s\n", argv[i]);
+		printf("constexpr Uint32 %s_data[%d] = {", name.c_str(), x_res * y_res);
+		for (int j = 0; j < x_res * y_res; j++) {
+			unsigned char* raw_pixel = raw_data + j * 3;
+			unsigned int pixel = 0xFF000000 | raw_pixel[0] << 16 | raw_pixel[1] << 8 | raw_pixel[2];
+			printf("%s0x%08X", j == 0 ? "\n\t" : j % 8 ? ", " : ",\n\t", pixel);
+		}
+		printf("\n};\n");
+		printf("constexpr EmbeddedSheet %s = {%s_data, %d, %d};\n", name.c_str(), name.c_str(), x_res, y_res);
+
+		// Free the original sprite.
+		stbi_image_free(raw_data);
+	}
+	exit(EXIT_SUCCESS);
+}
\ No newline at end of file
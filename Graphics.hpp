@@ -1,5 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+#include <algorithm>
+
+// A sprite sheet uploaded to the renderer as a texture.
+struct TextureAtlas {
+	SDL_Texture* texture;
+	int x_res;
+	int y_res;
+};
 
 // A graphics adapter.
 class Graphics {
@@ -9,6 +20,179 @@ private:
 	SDL_Renderer* sdl_renderer = NULL;
 	SDL_Texture* sdl_texture = NULL;
 
+	// Texture atlases owned by this adapter.
+	std::vector<SDL_Texture*> atlases;
+
+	// Batched geometry, drawn on top of the video memory in a single call.
+	SDL_Texture* batch_texture = NULL;
+	std::vector<SDL_Vertex> batch_vertices;
+	std::vector<int> batch_indices;
+
+	// Rectangles of the video memory that are drawn again on top of the
+	// batched geometry.
+	std::vector<SDL_Rect> overlays;
+
+	// A flag for each row of the indexed video memory that was drawn since it
+	// was last expanded. Bands drawn on different threads set different
+	// flags.
+	std::vector<Uint8> indexed_rows;
+
+	// A row of expanded pixels, for stretching indexed rows in software.
+	std::vector<Uint32> expanded_row;
+
+	// The rows of the video memory that changed since the last push, y0 to
+	// y1 (exclusive).
+	int dirty_y0 = 0;
+	int dirty_y1 = 0;
+
+	// Draw straight into the streaming texture's memory, which is locked
+	// between lock() and push(), instead of into a separate video memory.
+	bool lock_texture = false;
+	bool locked = false;
+
+	// Stretch the video memory by the scale in software, into a texture that
+	// is as large as the window, instead of leaving it to the renderer.
+	bool software_scale = false;
+
+	// Stretch rows y0 to y1 (exclusive) of the video memory into the
+	// SDL_Texture*.
+	void upscale_rows(int y0, int y1) {
+		SDL_Rect rows = {0, y0 * int(scale), x_res * int(scale), (y1 - y0) * int(scale)};
+		void* pixels;
+		int bytes;
+		if (SDL_LockTexture(sdl_texture, &rows, &pixels, &bytes) != 0) {
+			barf("Could not lock the SDL_Texture*.");
+		}
+		upscale(video + y0 * pitch, pitch * sizeof(Uint32), (Uint8*)pixels, bytes, x_res, y1 - y0, scale);
+		SDL_UnlockTexture(sdl_texture);
+	}
+
+	// Flag the rows of the indexed video memory that a rectangle covers
+	// within the clipping rectangle as drawn.
+	inline void mark_indexed(int x, int y, int w, int h) {
+		int y0 = std::max(y, clip_y0);
+		int y1 = std::min(y + h, clip_y1);
+		if (std::max(x, clip_x0) < std::min(x + w, clip_x1) && y0 < y1) {
+			memset(&indexed_rows[y0], 1, y1 - y0);
+		}
+	}
+
+	// Expand rows y0 to y1 (exclusive) of the indexed video memory into the
+	// video memory, or, when there is none, straight into the SDL_Texture*.
+	void expand_rows(int y0, int y1) {
+		if (video) {
+			for (int y = y0; y < y1; y++) {
+				palette.expand(indexed_video + y * x_res, video + y * pitch, x_res);
+			}
+			mark_dirty(y0, y1);
+			return;
+		}
+		if (headless()) {
+			return;
+		}
+		int texture_scale = software_scale ? scale : 1;
+		SDL_Rect rows = {0, y0 * texture_scale, x_res * texture_scale, (y1 - y0) * texture_scale};
+		void* pixels;
+		int bytes;
+		if (SDL_LockTexture(sdl_texture, &rows, &pixels, &bytes) != 0) {
+			barf("Could not lock the SDL_Texture*.");
+		}
+		for (int y = y0; y < y1; y++) {
+			const Uint8* row = indexed_video + y * x_res;
+			Uint8* out = (Uint8*)pixels + (y - y0) * texture_scale * bytes;
+			if (software_scale) {
+				palette.expand(row, expanded_row.data(), x_res);
+				upscale(expanded_row.data(), x_res * sizeof(Uint32), out, bytes, x_res, 1, scale);
+			} else {
+				palette.expand(row, (Uint32*)out, x_res);
+			}
+		}
+		SDL_UnlockTexture(sdl_texture);
+	}
+
+	// Add rows y0 to y1 (exclusive) to the rows that changed.
+	void mark_dirty(int y0, int y1) {
+		if (dirty_y0 >= dirty_y1) {
+			dirty_y0 = y0;
+			dirty_y1 = y1;
+		} else {
+			dirty_y0 = std::min(dirty_y0, y0);
+			dirty_y1 = std::max(dirty_y1, y1);
+		}
+	}
+
+	// Fill a rectangle of a video memory with a value. The stride is the
+	// number of pixels per row of the video memory.
+	template <typename Pixel>
+	inline void fill_rect(Pixel* target, int stride, int x, int y, int w, int h, Pixel pixel) {
+		int x0 = std::max(x, clip_x0);
+		int y0 = std::max(y, clip_y0);
+		int x1 = std::min(x + w, clip_x1);
+		int y1 = std::min(y + h, clip_y1);
+		if (x0 >= x1) {
+			return;
+		}
+		for (int j = y0; j < y1; j++) {
+			std::fill(target + j * stride + x0, target + j * stride + x1, pixel);
+		}
+	}
+
+	// Copy the pixels of a sprite, stretched to w by h pixels (nearest
+	// neighbour), to a video memory.
+	template <typename Pixel>
+	inline void copy_sprite(Pixel* target, int stride, const Pixel* source, int x_res, int y_res, int x, int y, int w, int h) {
+		// Only visit the part of the sprite that lies within the clipping
+		// rectangle.
+		int i0 = std::max(clip_x0 - x, 0);
+		int j0 = std::max(clip_y0 - y, 0);
+		int i1 = std::min(clip_x1 - x, w);
+		int j1 = std::min(clip_y1 - y, h);
+		if (w == x_res && h == y_res) {
+			for (int j = j0; j < j1; j++) {
+				const Pixel* row = source + j * x_res;
+				std::copy(row + i0, row + i1, target + (y + j) * stride + x + i0);
+			}
+			return;
+		}
+		for (int j = j0; j < j1; j++) {
+			const Pixel* row = source + j * y_res / h * x_res;
+			Pixel* out = target + (y + j) * stride + x;
+			for (int i = i0; i < i1; i++) {
+				out[i] = row[i * x_res / w];
+			}
+		}
+	}
+
+	// Destroy all SDL objects and free the video memory.
+	void release() {
+		if (locked) {
+			SDL_UnlockTexture(sdl_texture);
+			locked = false;
+		} else {
+			free(video);
+		}
+		video = NULL;
+		free(indexed_video);
+		indexed_video = NULL;
+		for (SDL_Texture* atlas: atlases) {
+			SDL_DestroyTexture(atlas);
+		}
+		atlases.clear();
+		batch_texture = NULL;
+		if (sdl_texture) {
+			SDL_DestroyTexture(sdl_texture);
+			sdl_texture = NULL;
+		}
+		if (sdl_renderer) {
+			SDL_DestroyRenderer(sdl_renderer);
+			sdl_renderer = NULL;
+		}
+		if (sdl_window) {
+			SDL_DestroyWindow(sdl_window);
+			sdl_window = NULL;
+		}
+	}
+
 	// Barf a message and exit.
 	void barf(const char* error) {
 		fprintf(stderr, "%s\n", error);
@@ -17,63 +201,363 @@ private:
 	
 public:
 	// Dimensions of the SDL_Window*.
-	int x_res;
-	int y_res;
-	unsigned int scale;
+	int x_res = 0;
+	int y_res = 0;
+	unsigned int scale = 1;
 
-	// Video memory pointer.
+	// The clipping rectangle.
+	int clip_x0 = 0;
+	int clip_y0 = 0;
+	int clip_x1 = 0;
+	int clip_y1 = 0;
+
+	// Video memory pointer, and the number of pixels per row of the video
+	// memory. With indexed color there is no video memory, except for the
+	// locked texture.
 	Uint32* video = NULL;
+	int pitch = 0;
+
+	// Indexed video memory pointer, if indexed color is used. Drawing then
+	// writes palette indices here. The rows that were drawn are expanded
+	// straight into the texture when the frame is pushed, and a saved frame
+	// is expanded from here.
+	Uint8* indexed_video = NULL;
+
+	// The colors of the indexed video memory.
+	Palette palette;
 
 	// Quit.
 	void quit() {
-		// Free the video memory.
-		free(video);
-		// Destroy all SDL objects.
-		SDL_DestroyTexture(sdl_texture);
-		SDL_DestroyRenderer(sdl_renderer);
-		SDL_DestroyWindow(sdl_window);
+		// Destroy all SDL objects and free the video memory.
+		release();
 		// Quit SDL.
 		SDL_Quit();
-		// Exit.
-		exit(EXIT_SUCCESS);
 	}
 	
-	// Set the value of a certain pixel of the video memory. No bounds
-	// checking is done in this function.
+	// Draw into indexed video memory from now on, which replaces the video
+	// memory. Sprites must be packed with this adapter's palette.
+	void use_indexed_color() {
+		if (indexed_video) {
+			return;
+		}
+		indexed_video = (Uint8*)calloc(x_res * y_res, 1);
+		if (!indexed_video)
+			barf("Could not allocate indexed video memory.");
+		indexed_rows.assign(y_res, 1);
+		if (software_scale) {
+			expanded_row.resize(x_res);
+		}
+		if (!locked) {
+			free(video);
+			video = NULL;
+		}
+	}
+
+	// Find the pixel value that set() takes for a color. Without indexed
+	// color this is the color itself, otherwise it is the color's palette
+	// index. Not thread-safe, as a new color is added to the palette.
+	Uint32 pen(Uint32 color) {
+		if (!indexed_video) {
+			return color;
+		}
+		int index = palette.index(color);
+		if (index < 0) {
+			barf("Too many colors for indexed video memory.");
+		}
+		return index;
+	}
+
+	// Set the value of a certain pixel of the video memory to a pen (see
+	// pen()). No bounds checking is done in this function.
 	inline void set(int x, int y, Uint32 pixel) {
-		video[y * x_res + x] = pixel;
+		if (indexed_video) {
+			indexed_video[y * x_res + x] = pixel;
+			indexed_rows[y] = 1;
+		} else {
+			video[y * pitch + x] = pixel;
+		}
 	}
 
-	// Set the value of a certain pixel of the video memory. Bounds checking is
-	// done in this function.
+	// Set the value of a certain pixel of the video memory to a pen (see
+	// pen()). Bounds checking is done in this function.
 	inline void set_safe(int x, int y, Uint32 pixel) {
 		if (x >= 0 && x < x_res)
 		if (y >= 0 && y < y_res) {
-			video[y * x_res + x] = pixel;
+			set(x, y, pixel);
+		}
+	}
+
+	// Restrict drawing to a rectangle of the video memory.
+	void clip(int x, int y, int w, int h) {
+		clip_x0 = std::max(x, 0);
+		clip_y0 = std::max(y, 0);
+		clip_x1 = std::min(x + w, x_res);
+		clip_y1 = std::min(y + h, y_res);
+	}
+
+	// Allow drawing to the whole video memory.
+	void unclip() {
+		clip(0, 0, x_res, y_res);
+	}
+
+	// Fill a rectangle with a solid color.
+	inline void fill(int x, int y, int w, int h, Uint32 color) {
+		if (indexed_video) {
+			fill_rect<Uint8>(indexed_video, x_res, x, y, w, h, pen(color));
+			mark_indexed(x, y, w, h);
+		} else {
+			fill_rect<Uint32>(video, pitch, x, y, w, h, color);
 		}
 	}
 
 	// Draw a sprite.
-	inline void draw_sprite(Sprite sprite, int x, int y) {
-		for (int j = 0; j < sprite.y_res; j++) {
-			for (int i = 0; i < sprite.x_res; i++) {
-				set_safe(x + i, y + j, sprite.data[j * sprite.x_res + i]);
+	inline void draw_sprite(const Sprite& sprite, int x, int y) {
+		draw_sprite_scaled(sprite, x, y, sprite.x_res, sprite.y_res);
+	}
+
+	// Draw a sprite stretched to w by h pixels (nearest neighbour).
+	inline void draw_sprite_scaled(const Sprite& sprite, int x, int y, int w, int h) {
+		if (indexed_video) {
+			copy_sprite<Uint8>(indexed_video, x_res, sprite.indices, sprite.x_res, sprite.y_res, x, y, w, h);
+			mark_indexed(x, y, w, h);
+		} else {
+			copy_sprite<Uint32>(video, pitch, sprite.data, sprite.x_res, sprite.y_res, x, y, w, h);
+		}
+	}
+
+	// Bring the texture up to date. Only the rows of the indexed video memory
+	// that were drawn since the last call are expanded, a run of rows at a
+	// time. Without indexed color the whole video memory may have changed.
+	void expand() {
+		if (!indexed_video) {
+			mark_dirty(0, y_res);
+			return;
+		}
+		int y = 0;
+		while (y < y_res) {
+			if (!indexed_rows[y]) {
+				y++;
+				continue;
+			}
+			int y1 = y + 1;
+			while (y1 < y_res && indexed_rows[y1]) {
+				y1++;
 			}
+			expand_rows(y, y1);
+			memset(&indexed_rows[y], 0, y1 - y);
+			y = y1;
+		}
+	}
+
+	// Draw straight into the streaming texture from now on. This saves
+	// copying the video memory to the texture, but the texture's memory
+	// holds no earlier frame, so every frame must be drawn in full. Does
+	// nothing without a window, or when the video memory is stretched in
+	// software.
+	void use_locked_texture() {
+		if (headless() || software_scale || lock_texture) {
+			return;
 		}
+		free(video);
+		video = NULL;
+		lock_texture = true;
+	}
+
+	// Prepare the video memory for a new frame. Returns true if the video
+	// memory doesn't hold the last frame, so the new frame must be drawn in
+	// full.
+	bool lock() {
+		if (!lock_texture || locked) {
+			return false;
+		}
+		void* pixels;
+		int bytes;
+		if (SDL_LockTexture(sdl_texture, NULL, &pixels, &bytes) != 0) {
+			barf("Could not lock the SDL_Texture*.");
+		}
+		video = (Uint32*)pixels;
+		pitch = bytes / sizeof(Uint32);
+		locked = true;
+		if (indexed_video) {
+			std::fill(indexed_rows.begin(), indexed_rows.end(), 1);
+		}
+		return true;
+	}
+
+	// Upload a sprite sheet to the renderer as a texture atlas.
+	TextureAtlas create_atlas(const Sprite& sheet) {
+		SDL_Texture* texture = SDL_CreateTexture(
+			sdl_renderer,
+			SDL_PIXELFORMAT_ARGB8888,
+			SDL_TEXTUREACCESS_STATIC,
+			sheet.x_res,
+			sheet.y_res
+		);
+
+		if (!texture) {
+			barf("Could not create a SDL_Texture* atlas.");
+		}
+
+		SDL_UpdateTexture(texture, NULL, sheet.data, sheet.x_res * sizeof(Uint32));
+		atlases.push_back(texture);
+		return {texture, sheet.x_res, sheet.y_res};
+	}
+
+	// Queue a section of a texture atlas to be drawn on top of the video
+	// memory, stretched to the destination rectangle and cut to the clipping
+	// rectangle. Consecutive sections of the same atlas are drawn with a
+	// single SDL_RenderGeometry call when the frame is pushed.
+	inline void draw_atlas(const TextureAtlas& atlas, SDL_Rect src, SDL_Rect dst) {
+		// Clip the destination rectangle.
+		int x0 = std::max(dst.x, clip_x0);
+		int y0 = std::max(dst.y, clip_y0);
+		int x1 = std::min(dst.x + dst.w, clip_x1);
+		int y1 = std::min(dst.y + dst.h, clip_y1);
+		if (x0 >= x1 || y0 >= y1) {
+			return;
+		}
+
+		if (batch_texture != atlas.texture) {
+			flush();
+			batch_texture = atlas.texture;
+		}
+
+		// Texture coordinates are normalized to the size of the atlas, and cut
+		// by the same fraction as the destination rectangle.
+		float u0 = (src.x + float(x0 - dst.x) * src.w / dst.w) / atlas.x_res;
+		float v0 = (src.y + float(y0 - dst.y) * src.h / dst.h) / atlas.y_res;
+		float u1 = (src.x + float(x1 - dst.x) * src.w / dst.w) / atlas.x_res;
+		float v1 = (src.y + float(y1 - dst.y) * src.h / dst.h) / atlas.y_res;
+
+		SDL_Color white = {255, 255, 255, 255};
+		int base = batch_vertices.size();
+		batch_vertices.push_back({{float(x0), float(y0)}, white, {u0, v0}});
+		batch_vertices.push_back({{float(x1), float(y0)}, white, {u1, v0}});
+		batch_vertices.push_back({{float(x0), float(y1)}, white, {u0, v1}});
+		batch_vertices.push_back({{float(x1), float(y1)}, white, {u1, v1}});
+
+		// Two triangles per quad.
+		batch_indices.push_back(base + 0);
+		batch_indices.push_back(base + 1);
+		batch_indices.push_back(base + 2);
+		batch_indices.push_back(base + 1);
+		batch_indices.push_back(base + 3);
+		batch_indices.push_back(base + 2);
+	}
+
+	// Draw the queued geometry.
+	void flush() {
+		if (batch_indices.empty()) {
+			return;
+		}
+		if (SDL_RenderGeometry(
+			sdl_renderer,
+			batch_texture,
+			batch_vertices.data(),
+			batch_vertices.size(),
+			batch_indices.data(),
+			batch_indices.size()
+		) != 0) {
+			barf("Could not render geometry.");
+		}
+		batch_vertices.clear();
+		batch_indices.clear();
+	}
+
+	// Keep a rectangle of the video memory on top of the batched geometry in
+	// the next frame.
+	void overlay(SDL_Rect rect) {
+		overlays.push_back(rect);
 	}
 
 	// Null constructor.
 	Graphics() {}
+
+	// A graphics adapter owns its SDL objects and video memory, so it can be
+	// moved but not copied.
+	Graphics(const Graphics&) = delete;
+	Graphics& operator=(const Graphics&) = delete;
+
+	// Move constructor.
+	Graphics(Graphics&& other) {
+		swap(other);
+	}
+
+	// Move assignment. The other adapter releases what this one held.
+	Graphics& operator=(Graphics&& other) {
+		swap(other);
+		return *this;
+	}
+
+	// Destructor.
+	~Graphics() {
+		release();
+	}
+
+	// Exchange the contents of two adapters.
+	void swap(Graphics& other) {
+		std::swap(sdl_window, other.sdl_window);
+		std::swap(sdl_renderer, other.sdl_renderer);
+		std::swap(sdl_texture, other.sdl_texture);
+		std::swap(atlases, other.atlases);
+		std::swap(batch_texture, other.batch_texture);
+		std::swap(batch_vertices, other.batch_vertices);
+		std::swap(batch_indices, other.batch_indices);
+		std::swap(overlays, other.overlays);
+		std::swap(x_res, other.x_res);
+		std::swap(y_res, other.y_res);
+		std::swap(scale, other.scale);
+		std::swap(clip_x0, other.clip_x0);
+		std::swap(clip_y0, other.clip_y0);
+		std::swap(clip_x1, other.clip_x1);
+		std::swap(clip_y1, other.clip_y1);
+		std::swap(video, other.video);
+		std::swap(pitch, other.pitch);
+		std::swap(dirty_y0, other.dirty_y0);
+		std::swap(dirty_y1, other.dirty_y1);
+		std::swap(lock_texture, other.lock_texture);
+		std::swap(locked, other.locked);
+		std::swap(software_scale, other.software_scale);
+		std::swap(indexed_video, other.indexed_video);
+		std::swap(indexed_rows, other.indexed_rows);
+		std::swap(expanded_row, other.expanded_row);
+		std::swap(palette, other.palette);
+	}
+
+	// Headless constructor. Only video memory is allocated, so nothing is
+	// shown and SDL's video subsystem is never used. Frames are read back
+	// with save_png() or snapshot().
+	Graphics(int x_res, int y_res) {
+		this->x_res = x_res;
+		this->y_res = y_res;
+		this->scale = 1;
+		unclip();
+
+		// Allocate video memory.
+		video = (Uint32*)malloc(x_res * y_res * sizeof(Uint32));
+		pitch = x_res;
+
+		if (!video)
+			barf("Could not allocate video memory.");
+	}
+
+	// Check if this adapter has no window.
+	bool headless() {
+		return !sdl_window;
+	}
 	
-	// Default constructor.
+	// Default constructor. With vsync, push() waits for the display's
+	// vertical blank.
 	Graphics(const char* title,
 			 int x_res,
 			 int y_res,
-			 unsigned int scale)
+			 unsigned int scale,
+			 bool vsync = false)
 	{
 		this->x_res = x_res;
 		this->y_res = y_res;
 		this->scale = scale;
+		unclip();
 		
 		// Create the SDL_Window*.
 		sdl_window = SDL_CreateWindow(
@@ -98,20 +582,32 @@ public:
 			-1,
 			// Some systems may have a GPU-accelerated renderer. On other
 			// systems the renderer will fall back to software.
-			SDL_RENDERER_ACCELERATED
+			SDL_RENDERER_ACCELERATED | (vsync ? SDL_RENDERER_PRESENTVSYNC : 0)
 		);
 		
 		if (!sdl_renderer) {
 			barf("Could not create a SDL_Renderer*.");
 		}
+
+		// Render in video memory coordinates, so that batched geometry lines
+		// up with the video memory regardless of the scale.
+		SDL_RenderSetLogicalSize(sdl_renderer, x_res, y_res);
+
+		// A software renderer stretches textures slowly and not always
+		// pixel-exactly, so stretch the video memory in software instead.
+		SDL_RendererInfo info;
+		if (scale > 1 && SDL_GetRendererInfo(sdl_renderer, &info) == 0 && (info.flags & SDL_RENDERER_SOFTWARE)) {
+			software_scale = true;
+		}
 		
 		// Create the SDL_Texture*.
+		int texture_scale = software_scale ? scale : 1;
 		sdl_texture = SDL_CreateTexture(
 			sdl_renderer,
 			SDL_PIXELFORMAT_ARGB8888,
 			SDL_TEXTUREACCESS_STREAMING,
-			x_res,
-			y_res
+			x_res * texture_scale,
+			y_res * texture_scale
 		);
 		
 		if (!sdl_texture) {
@@ -120,47 +616,67 @@ public:
 		
 		// Allocate video memory.
 		video = (Uint32*)malloc(x_res * y_res * sizeof(Uint32));
+		pitch = x_res;
 		
 		if (!video)
 			barf("Could not allocate video memory.");
 	}
 	
 	// Video output function.
-	Uint32 previous_ticks = 0;
 	void push() {
-		previous_ticks = SDL_GetTicks();
-		// Update the SDL_Texture*.
-		SDL_UpdateTexture(sdl_texture, NULL, video, x_res * sizeof(Uint32));
+		if (headless()) {
+			return;
+		}
+		expand();
+		if (locked) {
+			// The frame was drawn straight into the SDL_Texture*.
+			SDL_UnlockTexture(sdl_texture);
+			video = NULL;
+			locked = false;
+		} else if (dirty_y0 < dirty_y1 && software_scale) {
+			// Stretch the rows that changed into the SDL_Texture*.
+			upscale_rows(dirty_y0, dirty_y1);
+		} else if (dirty_y0 < dirty_y1) {
+			// Update the rows of the SDL_Texture* that changed.
+			SDL_Rect rows = {0, dirty_y0, x_res, dirty_y1 - dirty_y0};
+			SDL_UpdateTexture(sdl_texture, &rows, video + dirty_y0 * pitch, pitch * sizeof(Uint32));
+		}
+		dirty_y0 = 0;
+		dirty_y1 = 0;
 		// Copy the SDL_Texture* to the SDL_Renderer*.
 		SDL_RenderCopy(sdl_renderer, sdl_texture, NULL, NULL);
+		// Draw the queued geometry on top of the video memory.
+		flush();
+		// Draw the overlays on top of the geometry.
+		int texture_scale = software_scale ? scale : 1;
+		for (SDL_Rect& rect: overlays) {
+			SDL_Rect src = {rect.x * texture_scale, rect.y * texture_scale, rect.w * texture_scale, rect.h * texture_scale};
+			SDL_RenderCopy(sdl_renderer, sdl_texture, &src, &rect);
+		}
+		overlays.clear();
 		// Update the SDL_Renderer*.
 		SDL_RenderPresent(sdl_renderer);
 	}
 
-	// Cap the framerate.
-	void cap(int fps) {
-		Uint32 ms = 1000 / fps;
-		Uint32 current_ticks = SDL_GetTicks();
-		Uint32 elapsed_ticks = current_ticks - previous_ticks;
-		if (elapsed_ticks < ms) {
-			SDL_Delay(ms - elapsed_ticks);
+	// Copy the video buffer into pixels, x_res pixels per row.
+	void snapshot(std::vector<Uint32>& pixels) {
+		pixels.resize((size_t)x_res * y_res);
+		for (int y = 0; y < y_res; y++) {
+			if (indexed_video) {
+				palette.expand(indexed_video + (size_t)y * x_res, &pixels[(size_t)y * x_res], x_res);
+			} else {
+				memcpy(&pixels[(size_t)y * x_res], video + (size_t)y * pitch, x_res * sizeof(Uint32));
+			}
 		}
 	}
 
-	// Save the video buffer as a .bmp file.
-	void save_bmp(std::string filename) {
-		// Create a SDL_Surface* from the video memory.
-		SDL_Surface* surface = SDL_CreateRGBSurfaceFrom(
-			video,
-			x_res,
-			y_res,
-			32,
-			x_res * 4,
-			0, 0, 0, 0
-		);
-		// Save the SDL_Surface*.
-		SDL_SaveBMP(surface, filename.c_str());
-		// Free the SDL_Surface*.
-		SDL_FreeSurface(surface);
+	// Save the video buffer as a .png file.
+	bool save_png(std::string filename) {
+		if (indexed_video) {
+			std::vector<Uint32> pixels;
+			snapshot(pixels);
+			return Png::write(filename, pixels.data(), x_res, y_res, x_res);
+		}
+		return Png::write(filename, video, x_res, y_res, pitch);
 	}
 };
\ No newline at end of file
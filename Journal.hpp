@@ -0,0 +1,318 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Journal records. A journal file starts with the magic "MSWPJRNL" and a
+// version, followed by records in the format of replay records (see
+// Replay.hpp). The first record starts the game, either as a REPLAY_GAME
+// record of a new game from its seed or as a JOURNAL_SNAPSHOT record, whose
+// value is zero, followed by a saved game in the format of a file (see
+// SaveGame.hpp). The actions on the game and its result follow.
+enum {
+	JOURNAL_SNAPSHOT = REPLAY_KINDS
+};
+
+// Journals the current game, so that it can be resumed exactly after a
+// crash. Actions are appended to the journal in memory by the game and
+// handed to a writer thread at most once a frame, without ever waiting for
+// it, and the writer syncs each batch to the disk. When the game starts or
+// the actions outweigh a snapshot of the game, the journal starts over: the
+// writer writes the new start and the actions after it to a temporary file
+// and renames it over the journal, so the journal on the disk is always
+// whole.
+class Journal {
+public:
+	static const Uint32 VERSION = 1;
+
+private:
+	// The most batches of records waiting for the writer.
+	static const size_t MAX_BATCHES = 16;
+	// The fewest bytes of actions that start the journal over.
+	static const size_t MIN_COMPACT = 65536;
+
+	// Records, either appended to the journal or starting it over with a new
+	// game or a snapshot: the game's state and a copy of its cells.
+	struct Batch {
+		bool fresh = false;
+		bool snapshot = false;
+		SaveGame saved;
+		std::vector<Uint8> cells;
+		Uint32 ticks = 0;
+		std::vector<Uint8> records;
+	};
+
+	std::string filename;
+	FILE* file = NULL;
+	bool failed = false;
+
+	// Records not yet handed to the writer, the time of the last record and
+	// the cell of the last action.
+	Batch pending;
+	Uint32 last_ticks = 0;
+	Sint64 last_cell = 0;
+
+	// The bytes of actions since the journal started over, and how many start
+	// it over again.
+	size_t logged = 0;
+	size_t compact_size = 0;
+
+	BackgroundWriter<Batch> writer;
+
+	// Write a round of batches and sync once.
+	void write(std::deque<Batch>& batches) {
+		for (Batch& batch: batches) {
+			put_batch(batch);
+		}
+		if (file && !sync(file)) {
+			fail();
+		}
+	}
+
+	// Write a batch to the file.
+	void put_batch(Batch& batch) {
+		if (!batch.fresh) {
+			if (file && fwrite(batch.records.data(), 1, batch.records.size(), file) != batch.records.size()) {
+				fail();
+			}
+			return;
+		}
+		std::vector<Uint8> out;
+		const char* magic = "MSWPJRNL";
+		out.insert(out.end(), magic, magic + 8);
+		put_le(out, VERSION, 4);
+		if (batch.snapshot) {
+			put_varint(out, batch.ticks);
+			put_varint(out, JOURNAL_SNAPSHOT);
+			pack_cells(batch.saved, batch.cells.data(), batch.cells.size());
+			batch.saved.put(out);
+		}
+		out.insert(out.end(), batch.records.begin(), batch.records.end());
+		if (file) {
+			fclose(file);
+		}
+		std::string temporary = filename + ".tmp";
+		file = fopen(temporary.c_str(), "wb");
+		bool ok = file && fwrite(out.data(), 1, out.size(), file) == out.size() && sync(file);
+		if (file) {
+			ok = fclose(file) == 0 && ok;
+		}
+#ifdef _WIN32
+		remove(filename.c_str());
+#endif
+		ok = ok && rename(temporary.c_str(), filename.c_str()) == 0;
+		file = ok ? fopen(filename.c_str(), "ab") : NULL;
+		if (!file) {
+			fail();
+			return;
+		}
+#ifndef _WIN32
+		// Sync the rename too.
+		size_t slash = filename.rfind('/');
+		std::string directory = slash == std::string::npos ? "." : filename.substr(0, slash + 1);
+		int handle = ::open(directory.c_str(), O_RDONLY);
+		if (handle >= 0) {
+			fsync(handle);
+			::close(handle);
+		}
+#endif
+	}
+
+	// Flush a file and sync it to the disk. Returns false if it fails.
+	bool sync(FILE* file) {
+		if (!file || fflush(file) != 0) {
+			return false;
+		}
+#ifndef _WIN32
+		return fsync(fileno(file)) == 0;
+#else
+		return true;
+#endif
+	}
+
+	// Report the first failure to write.
+	void fail() {
+		if (!failed) {
+			fprintf(stderr, "Could not write \"%s\", so the game can't be resumed.\n", filename.c_str());
+			failed = true;
+		}
+	}
+
+	// Start a record.
+	void put_record(int kind, Uint64 value, Uint32 ticks) {
+		put_varint(pending.records, ticks - last_ticks);
+		put_varint(pending.records, kind | value << 3);
+		last_ticks = ticks;
+	}
+
+public:
+	// Default constructor. The journal is written when the game starts.
+	Journal(std::string filename):
+		filename(filename),
+		writer(MAX_BATCHES, [this](std::deque<Batch>& batches) { write(batches); })
+	{
+	}
+
+	// Destructor. Waits for every record to be written.
+	~Journal() {
+		if (pending.fresh || !pending.records.empty()) {
+			writer.stop(pending);
+		}
+		writer.stop();
+		if (file) {
+			fclose(file);
+		}
+	}
+
+	Journal(const Journal&) = delete;
+	Journal& operator=(const Journal&) = delete;
+
+	// Start the journal over with a new game.
+	void game(int x_cells, int y_cells, int mines, Uint64 seed, Uint32 ticks) {
+		pending = Batch();
+		pending.fresh = true;
+		last_ticks = 0;
+		put_record(REPLAY_GAME, 0, ticks);
+		last_cell = 0;
+		put_varint(pending.records, x_cells);
+		put_varint(pending.records, y_cells);
+		put_varint(pending.records, mines);
+		put_le(pending.records, seed, 8);
+		logged = 0;
+		compact_size = std::max(size_t(MIN_COMPACT), size_t(x_cells) * y_cells * 3 / 8);
+	}
+
+	// Start the journal over with a snapshot of the game: its state, without
+	// its planes, and a copy of its cells, which the writer packs.
+	void snapshot(SaveGame&& saved, std::vector<Uint8>&& cells, Uint32 ticks) {
+		pending = Batch();
+		pending.fresh = true;
+		pending.snapshot = true;
+		pending.ticks = ticks;
+		last_ticks = ticks;
+		last_cell = 0;
+		logged = 0;
+		compact_size = std::max(size_t(MIN_COMPACT), size_t(saved.x_cells) * saved.y_cells * 3 / 8);
+		pending.saved = std::move(saved);
+		pending.cells = std::move(cells);
+	}
+
+	// Journal an action on a cell.
+	void action(int kind, Sint64 cell, Uint32 ticks) {
+		size_t size = pending.records.size();
+		put_record(kind, zigzag(cell - last_cell), ticks);
+		last_cell = cell;
+		logged += pending.records.size() - size;
+	}
+
+	// Journal the result of the game.
+	void result(bool won, Uint32 elapsed, Uint32 ticks) {
+		put_record(won ? REPLAY_WIN : REPLAY_LOSS, elapsed, ticks);
+	}
+
+	// Check if the actions outweigh a snapshot, so that the journal should
+	// start over.
+	bool is_due() {
+		return logged > compact_size;
+	}
+
+	// Hand the records so far to the writer thread, unless it is busy. A new
+	// start replaces the batches still waiting.
+	void flush() {
+		if (!pending.fresh && pending.records.empty()) {
+			return;
+		}
+		if (writer.offer(pending, pending.fresh)) {
+			pending = Batch();
+		}
+	}
+};
+
+// The game of a journal file.
+struct JournalGame {
+	// The start of the game: a new game from its seed, or a snapshot.
+	bool snapshot = false;
+	ReplayRecord start;
+	SaveGame saved;
+
+	// The actions after it, and whether the game ended.
+	std::vector<ReplayRecord> actions;
+	bool finished = false;
+
+	// The time of the last record.
+	Uint32 ticks = 0;
+
+	// Read the game of a journal file. A record cut short by a crash and
+	// everything after it is left out. Returns false if the file can't be
+	// read or doesn't start a game.
+	bool read(std::string filename) {
+		std::vector<Uint8> data;
+		if (!read_file(filename, data)) {
+			return false;
+		}
+		Reader in(data.data(), data.size());
+		const Uint8* magic = in.skip(8);
+		if (!magic || memcmp(magic, "MSWPJRNL", 8) != 0 || in.le(4) != Journal::VERSION) {
+			return false;
+		}
+		ticks = in.varint();
+		Uint64 head = in.varint();
+		start.ticks = ticks;
+		if (head == JOURNAL_SNAPSHOT) {
+			snapshot = true;
+			if (!saved.get(in)) {
+				return false;
+			}
+			start.x_cells = saved.x_cells;
+			start.y_cells = saved.y_cells;
+			start.mines = saved.mines;
+			start.seed = saved.seed;
+		} else if (head == REPLAY_GAME) {
+			start.x_cells = in.varint();
+			start.y_cells = in.varint();
+			start.mines = in.varint();
+			start.seed = in.le(8);
+			if (!in.ok || start.x_cells <= 0 || start.y_cells <= 0 || start.mines < 0 ||
+				start.x_cells > SaveGame::MAX_SIDE || start.y_cells > SaveGame::MAX_SIDE ||
+				start.mines + 9 > Sint64(start.x_cells) * start.y_cells) {
+				return false;
+			}
+		} else {
+			return false;
+		}
+		Sint64 cells = Sint64(start.x_cells) * start.y_cells;
+		Sint64 last_cell = 0;
+		while (in.data != in.end && !finished) {
+			ReplayRecord record;
+			record.ticks = ticks + in.varint();
+			head = in.varint();
+			record.kind = head & 7;
+			Uint64 value = head >> 3;
+			if (record.kind == REPLAY_UNCOVER || record.kind == REPLAY_FLAG || record.kind == REPLAY_SOLVE) {
+				record.cell = last_cell + unzigzag(value);
+				if (!in.ok || record.cell < 0 || record.cell >= cells) {
+					break;
+				}
+				last_cell = record.cell;
+				actions.push_back(record);
+			} else if (record.kind == REPLAY_WIN || record.kind == REPLAY_LOSS) {
+				if (!in.ok) {
+					break;
+				}
+				finished = true;
+			} else {
+				break;
+			}
+			ticks = record.ticks;
+		}
+		return true;
+	}
+};
\ No newline at end of file
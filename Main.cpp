@@ -1,72 +1,317 @@
 #include <ctime>
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <future>
 #include <iostream>
 
 #include <SDL.h>
 
+#include "Palette.hpp"
 #include "Sprite.hpp"
+#include "Sheets.hpp"
+#include "Png.hpp"
+#include "Upscale.hpp"
+#include "Random.hpp"
+#include "Codec.hpp"
+#include "Writer.hpp"
+#include "SaveGame.hpp"
+#include "Board.hpp"
+#include "Replay.hpp"
+#include "Journal.hpp"
 #include "Graphics.hpp"
+#include "Screenshot.hpp"
+#include "Video.hpp"
+#include "Pacer.hpp"
+#include "ThreadPool.hpp"
+#include "Timeline.hpp"
+#include "Minimap.hpp"
+#include "DigitDisplay.hpp"
+#include "Stats.hpp"
 #include "Minesweeper.hpp"
+#include "Thumbnails.hpp"
+#include "Corpus.hpp"
+#include "Verify.hpp"
 
 // Print usage information and exit.
 void usage(char** argv) {
-	fprintf(stderr, "Usage: %s [<-b|-i|-e>|<W> <H> <M>]\n", argv[0]);
-	fprintf(stderr, "\t-b          Beginner mode (9x9 with 10 mines)\n");
-	fprintf(stderr, "\t-i          Intermediate mode (16x16 with 40 mines)\n");
-	fprintf(stderr, "\t-e          Expert mode (30x16 with 99 mines)\n");
-	fprintf(stderr, "\t<W> <H> <M> Custom mode (WxH with M mines)\n");
+	fprintf(stderr, "Usage: %s [options] [<-b|-i|-e>|<W> <H> <M>]\n", argv[0]);
+	fprintf(stderr, "\t-b              Beginner mode (9x9 with 10 mines)\n");
+	fprintf(stderr, "\t-i              Intermediate mode (16x16 with 40 mines)\n");
+	fprintf(stderr, "\t-e              Expert mode (30x16 with 99 mines)\n");
+	fprintf(stderr, "\t<W> <H> <M>     Custom mode (WxH with M mines)\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "\t--geometry      Draw the board as batched geometry\n");
+	fprintf(stderr, "\t--benchmark <N> Render N uncapped frames and print the frame time\n");
+	fprintf(stderr, "\t--threads <N>   Rasterise the board with N threads (0 for all cores)\n");
+	fprintf(stderr, "\t--viewport <W> <H>\n");
+	fprintf(stderr, "\t                Show at most WxH pixels of the board (default 640x480)\n");
+	fprintf(stderr, "\t--theme <dir>   Load the sprite sheets from a directory\n");
+	fprintf(stderr, "\t--render <N> <prefix>\n");
+	fprintf(stderr, "\t                Write N board thumbnails to <prefix>NNNNNN.png without a window\n");
+	fprintf(stderr, "\t--indexed       Draw into 8-bit indexed video memory\n");
+	fprintf(stderr, "\t--lock-texture  Draw straight into the locked streaming texture\n");
+	fprintf(stderr, "\t--fps <N>       Pace frames to N frames per second (0 for no limit, default 60)\n");
+	fprintf(stderr, "\t--vsync         Wait for the display's vertical blank\n");
+	fprintf(stderr, "\t--frame-stats   Print frame interval statistics when the game ends\n");
+	fprintf(stderr, "\t--seed <N>      Draw the game boards from seed N (default the time)\n");
+	fprintf(stderr, "\t--load <file>   Start with a saved game\n");
+	fprintf(stderr, "\t--board <file>  Keep the board in a memory-mapped file, created if needed\n");
+	fprintf(stderr, "\t--chunked       Create the board file as compressed chunks\n");
+	fprintf(stderr, "\t--record <file> Record the games to a replay file\n");
+	fprintf(stderr, "\t--journal <file>\n");
+	fprintf(stderr, "\t                Journal the game to a file, and resume a game of the same mode\n");
+	fprintf(stderr, "\t                journalled there after a crash\n");
+	fprintf(stderr, "\t--verify <file> Replay the games of a replay file without a window and\n");
+	fprintf(stderr, "\t                check their results (can be repeated)\n");
+	fprintf(stderr, "\t--video <file>  Record every frame to a video file\n");
+	fprintf(stderr, "\t--video-frames <file> <prefix>\n");
+	fprintf(stderr, "\t                Write the frames of a video file to <prefix>NNNNNN.png at\n");
+	fprintf(stderr, "\t                the --fps rate\n");
+	fprintf(stderr, "\t--corpus <N> <file>\n");
+	fprintf(stderr, "\t                Write the boards of N seeds from --seed on to a corpus file\n");
+	fprintf(stderr, "\t--min-3bv <N>   Only keep corpus boards with a 3BV of at least N\n");
+	fprintf(stderr, "\t--max-3bv <N>   Only keep corpus boards with a 3BV of at most N\n");
+	fprintf(stderr, "\t--no-guess      Only keep corpus boards that can be cleared without guessing\n");
+	fprintf(stderr, "\t--import-boards <text> <file>\n");
+	fprintf(stderr, "\t                Convert plain-text boards to a corpus file\n");
+	fprintf(stderr, "\t--export-boards <file> <text>\n");
+	fprintf(stderr, "\t                Convert a corpus file to plain-text boards\n");
+	fprintf(stderr, "\t--stats         Print the statistics of the games in --stats-file\n");
+	fprintf(stderr, "\t--stats-file <file>\n");
+	fprintf(stderr, "\t                Keep the statistics of the games played in a file\n");
+	fprintf(stderr, "\t--profile-startup\n");
+	fprintf(stderr, "\t                Print a timeline of the startup steps\n");
 	exit(EXIT_FAILURE);
 }
 
 // Entry point.
 int main(int argc, char** argv) {
+	// Parse the command line options.
+	Options options;
+	options.seed = time(NULL);
+	std::vector<std::string> args;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--geometry") {
+			options.geometry = true;
+		} else if (arg == "--benchmark") {
+			if (++i == argc) {
+				usage(argv);
+			}
+			options.benchmark = std::stoi(std::string(argv[i]));
+		} else if (arg == "--threads") {
+			if (++i == argc) {
+				usage(argv);
+			}
+			options.threads = std::stoi(std::string(argv[i]));
+		} else if (arg == "--viewport") {
+			if (i + 2 >= argc) {
+				usage(argv);
+			}
+			options.view_x_res = std::stoi(std::string(argv[++i]));
+			options.view_y_res = std::stoi(std::string(argv[++i]));
+		} else if (arg == "--theme") {
+			if (++i == argc) {
+				usage(argv);
+			}
+			options.theme = argv[i];
+		} else if (arg == "--render") {
+			if (i + 2 >= argc) {
+				usage(argv);
+			}
+			options.thumbnails = std::stoi(std::string(argv[++i]));
+			options.thumbnail_prefix = argv[++i];
+		} else if (arg == "--indexed") {
+			options.indexed = true;
+		} else if (arg == "--lock-texture") {
+			options.lock_texture = true;
+		} else if (arg == "--fps") {
+			if (++i == argc) {
+				usage(argv);
+			}
+			options.fps = std::stoi(std::string(argv[i]));
+		} else if (arg == "--vsync") {
+			options.vsync = true;
+		} else if (arg == "--frame-stats") {
+			options.frame_stats = true;
+		} else if (arg == "--seed") {
+			if (++i == argc) {
+				usage(argv);
+			}
+			options.seed = std::stoull(std::string(argv[i]));
+			options.resume = false;
+		} else if (arg == "--load") {
+			if (++i == argc) {
+				usage(argv);
+			}
+			options.load = argv[i];
+		} else if (arg == "--board") {
+			if (++i == argc) {
+				usage(argv);
+			}
+			options.board_file = argv[i];
+		} else if (arg == "--chunked") {
+			options.chunked = true;
+		} else if (arg == "--record") {
+			if (++i == argc) {
+				usage(argv);
+			}
+			options.record = argv[i];
+		} else if (arg == "--journal") {
+			if (++i == argc) {
+				usage(argv);
+			}
+			options.journal = argv[i];
+		} else if (arg == "--verify") {
+			if (++i == argc) {
+				usage(argv);
+			}
+			options.verify.push_back(argv[i]);
+		} else if (arg == "--video") {
+			if (++i == argc) {
+				usage(argv);
+			}
+			options.video = argv[i];
+		} else if (arg == "--video-frames") {
+			if (i + 2 >= argc) {
+				usage(argv);
+			}
+			options.video_frames = argv[++i];
+			options.video_frames_prefix = argv[++i];
+		} else if (arg == "--corpus") {
+			if (i + 2 >= argc) {
+				usage(argv);
+			}
+			options.corpus_seeds = std::stoull(std::string(argv[++i]));
+			options.corpus_file = argv[++i];
+		} else if (arg == "--min-3bv") {
+			if (++i == argc) {
+				usage(argv);
+			}
+			options.min_3bv = std::stoi(std::string(argv[i]));
+		} else if (arg == "--max-3bv") {
+			if (++i == argc) {
+				usage(argv);
+			}
+			options.max_3bv = std::stoi(std::string(argv[i]));
+		} else if (arg == "--no-guess") {
+			options.no_guess = true;
+		} else if (arg == "--import-boards" || arg == "--export-boards") {
+			if (i + 2 >= argc) {
+				usage(argv);
+			}
+			options.corpus_import = arg == "--import-boards";
+			options.corpus_export = !options.corpus_import;
+			options.corpus_text = argv[options.corpus_import ? i + 1 : i + 2];
+			options.corpus_file = argv[options.corpus_import ? i + 2 : i + 1];
+			i += 2;
+		} else if (arg == "--stats") {
+			options.print_stats = true;
+		} else if (arg == "--stats-file") {
+			if (++i == argc) {
+				usage(argv);
+			}
+			options.stats_file = argv[i];
+		} else if (arg == "--profile-startup") {
+			options.profile_startup = true;
+		} else if (arg.compare(0, 2, "--") == 0) {
+			usage(argv);
+		} else {
+			args.push_back(arg);
+		}
+	}
+
 	// Parse the command line arguments.
 	int w;
 	int h;
 	int mines;
-	if (argc != 1 && argc != 2 && argc != 4) {
+	if (args.size() != 0 && args.size() != 1 && args.size() != 3) {
 		usage(argv);
-	} else if (argc == 1) {
+	} else if (args.size() == 0) {
 		// Play in intermediate mode by default.
 		w = 16;
 		h = 16;
 		mines = 40;
-	} else if (argc == 2) {
-		if (std::string(argv[1]) == "-b") {
+	} else if (args.size() == 1) {
+		if (args[0] == "-b") {
 			w = 9;
 			h = 9;
 			mines = 10;
-		} else if (std::string(argv[1]) == "-i") {
+		} else if (args[0] == "-i") {
 			w = 16;
 			h = 16;
 			mines = 40;
-		} else if (std::string(argv[1]) == "-e") {
+		} else if (args[0] == "-e") {
 			w = 30;
 			h = 16;
 			mines = 99;
 		} else {
 			usage(argv);
 		}
-	} else if (argc == 4) {
-		w = std::stoi(std::string(argv[1]));
-		h = std::stoi(std::string(argv[2]));
-		mines = std::stoi(std::string(argv[3]));
+	} else if (args.size() == 3) {
+		w = std::stoi(args[0]);
+		h = std::stoi(args[1]);
+		mines = std::stoi(args[2]);
 	}
 
 	// Make sure the mine count is not insane.
-	if (mines > w * h - 10) {
-		mines = w * h - 10;
+	if (mines > Sint64(w) * h - 10) {
+		mines = Sint64(w) * h - 10;
 	}
 
-	// Create a game.
-	Minesweeper minesweeper = Minesweeper(w, h, mines);
+	// Verify replays without a window.
+	if (!options.verify.empty()) {
+		exit(verify_replays(options.verify, options) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// Export the frames of a video.
+	if (!options.video_frames.empty()) {
+		exit(export_video(options.video_frames, options.video_frames_prefix, options.fps) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
 
-	// Start and end the game.
-	minesweeper.start();
-	minesweeper.end();
+	// Generate or convert a board corpus.
+	if (options.corpus_import) {
+		exit(import_corpus(options.corpus_text, options.corpus_file) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	if (options.corpus_export) {
+		exit(export_corpus(options.corpus_file, options.corpus_text) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	if (options.corpus_seeds) {
+		exit(generate_corpus(w, h, mines, options) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// Print the statistics.
+	if (options.print_stats) {
+		if (options.stats_file.empty()) {
+			fprintf(stderr, "--stats needs --stats-file.\n");
+			exit(EXIT_FAILURE);
+		}
+		StatsStore stats(options.stats_file);
+		if (!stats.is_valid()) {
+			fprintf(stderr, "\"%s\" is not a statistics file.\n", options.stats_file.c_str());
+			exit(EXIT_FAILURE);
+		}
+		stats.print();
+		exit(EXIT_SUCCESS);
+	}
+
+	// Render thumbnails without a window.
+	if (options.thumbnails) {
+		render_thumbnails(w, h, mines, options);
+		exit(EXIT_SUCCESS);
+	}
+
+	// Create a game, then start and end it.
+	{
+		Minesweeper minesweeper(w, h, mines, options);
+		minesweeper.start();
+		minesweeper.end();
+	}
 
 	// Exit successfully.
 	exit(EXIT_SUCCESS);
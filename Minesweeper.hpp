@@ -20,7 +20,9 @@ enum {
 	TILE_UNUSED2,
 	TILE_MINE1,
 	TILE_MINE2,
-	TILE_MINE3
+	TILE_MINE3,
+	// The number tiles follow, up to the number of tiles.
+	TILES = 16
 };
 
 // Smiley constants.
@@ -32,13 +34,116 @@ enum {
 	SMILEY_SAD
 };
 
-// A cell.
-struct Cell {
-	int neighbours;
-	bool is_uncovered;
-	bool is_flagged;
-	bool is_mine;
-	bool is_culprit;
+// Find the level-of-detail code of a tile.
+inline Uint8 lod_code(int tile_type) {
+	static const Uint8 codes[16] = {
+		LOD_COVERED,
+		LOD_EMPTY,
+		LOD_FLAGGED,
+		LOD_COVERED,
+		LOD_COVERED,
+		LOD_MINE,
+		LOD_CULPRIT,
+		LOD_WRONG_FLAG,
+		LOD_NUMBER, LOD_NUMBER, LOD_NUMBER, LOD_NUMBER,
+		LOD_NUMBER, LOD_NUMBER, LOD_NUMBER, LOD_NUMBER
+	};
+	return codes[tile_type];
+}
+
+// Find the color of a level-of-detail code.
+inline Uint32 lod_color(Uint8 code) {
+	static const Uint32 colors[LOD_CODES] = {
+		rgb888(192, 192, 192),
+		rgb888(128, 128, 128),
+		rgb888(255, 255, 255),
+		rgb888(255,   0,   0),
+		rgb888(  0,   0,   0),
+		rgb888(128,   0,   0),
+		rgb888(255, 255,   0)
+	};
+	return colors[code];
+}
+
+// A game's options.
+struct Options {
+	// Draw the board as batched geometry from a texture atlas instead of
+	// rasterising it into the video memory.
+	bool geometry = false;
+	// Render this many frames without a framerate cap, print the average
+	// frame time and exit.
+	int benchmark = 0;
+	// The number of threads that rasterise the board. Zero uses every core.
+	int threads = 1;
+	// The largest viewport of the game board, in video memory pixels. Larger
+	// game boards are scrolled and zoomed with the camera.
+	int view_x_res = 640;
+	int view_y_res = 480;
+	// Render into video memory only, without a window.
+	bool headless = false;
+	// Load the sprite sheets from this directory instead of using the ones
+	// built into the executable.
+	std::string theme;
+	// Render this many thumbnails of played-out openings to files starting
+	// with thumbnail_prefix, and exit.
+	int thumbnails = 0;
+	std::string thumbnail_prefix;
+	// Print a timeline of the startup steps once the first frame is shown.
+	bool profile_startup = false;
+	// Draw into 8-bit indexed video memory, which is expanded to ARGB8888
+	// when the frame is pushed.
+	bool indexed = false;
+	// Draw straight into the locked streaming texture.
+	bool lock_texture = false;
+	// Pace frames to this many frames per second, or not at all if zero.
+	int fps = 60;
+	// Wait for the display's vertical blank when pushing a frame.
+	bool vsync = false;
+	// Print statistics of the intervals between frames when the game ends.
+	bool frame_stats = false;
+	// The seed that the seeds of the game boards are drawn from.
+	Uint64 seed = 0;
+	// Start with the saved game in this file instead of a new game.
+	std::string load;
+	// Keep the game board in this memory-mapped file, creating it if it
+	// doesn't exist, instead of in memory.
+	std::string board_file;
+	// Create the board file as compressed chunks instead of mapping it.
+	bool chunked = false;
+	// Record the games to this replay file.
+	std::string record;
+	// Journal the game to this file, if any, when there is a window, and
+	// unless a seed, a saved game or a board file is given, resume the
+	// unfinished game journalled there if it is of the same mode.
+	std::string journal;
+	bool resume = true;
+	// Replay the games of these replay files without rendering, check that
+	// they end as recorded, and exit.
+	std::vector<std::string> verify;
+	// Record every frame to this video file.
+	std::string video;
+	// Export the frames of this video file to files starting with
+	// video_frames_prefix, and exit.
+	std::string video_frames;
+	std::string video_frames_prefix;
+	// Generate the boards of this many seeds, from seed on, to corpus_file,
+	// keeping those whose 3BV lies between min_3bv and max_3bv and, with
+	// no_guess, those that can be cleared without guessing, and exit.
+	Uint64 corpus_seeds = 0;
+	std::string corpus_file;
+	int min_3bv = 0;
+	int max_3bv = INT_MAX;
+	bool no_guess = false;
+	// Convert the plain-text boards of corpus_text to corpus_file, or the
+	// other way around, and exit.
+	std::string corpus_text;
+	bool corpus_import = false;
+	bool corpus_export = false;
+	// Append every game played with a window to this statistics file, if
+	// any.
+	std::string stats_file;
+	// Print the statistics of the games played and exit.
+	bool print_stats = false;
 };
 
 // A Minesweeper game.
@@ -47,93 +152,381 @@ public:
 	// The graphics adapter.
 	Graphics adapter;
 
+	// The startup timeline.
+	Timeline timeline;
+
+	// The rasteriser threads.
+	ThreadPool pool;
+
+	// The frame pacer.
+	Pacer pacer;
+
 	// The game board.
-	Cell* board;
+	Board board;
+
+	// The version of board files.
+	static const Uint32 BOARD_VERSION = 1;
+
+	// The seed of each new game board is drawn from seeds. A game board is
+	// generated and diverted by random, which is seeded with seed, so that
+	// the game can be saved and replayed exactly.
+	Random seeds;
+	Uint64 seed = 0;
+	Random random;
+
+	// The replay recorder, if recording, and whether the current game can be
+	// recorded and counted in the statistics (a loaded game can't be replayed
+	// from its seed).
+	std::unique_ptr<ReplayWriter> recorder;
+	bool recording = false;
+
+	// The journal of the current game, if journalling with a window and no
+	// board file.
+	std::unique_ptr<Journal> journal;
+
+	// The screenshot writer, if there is a window and the board isn't drawn
+	// as geometry.
+	std::unique_ptr<ScreenshotWriter> screenshots;
 
-	// The sprites.
+	// The video recorder, if recording video.
+	std::unique_ptr<VideoWriter> video_writer;
+
+	// The statistics of the games played, if kept and there is a window, and
+	// the number of uncovers and flags in the current game.
+	std::unique_ptr<StatsStore> stats;
+	int clicks = 0;
+	std::vector<Uint8> bbbv_marks;
+	std::vector<size_t> bbbv_stack;
+	// The game that ended being counted and added to the statistics off the
+	// frame loop. It reads the board, so the board waits for it before it
+	// changes (see wait_stats()).
+	std::future<void> adding_stats;
+
+	// The game board's level-of-detail codes.
+	Minimap minimap;
+	bool show_minimap = true;
+	// Whether the codes are kept up to date. Games that are never rendered
+	// can skip it.
+	bool track_minimap = true;
+	const int minimap_size = 128;
+
+	// The game's options.
+	Options options;
+
+	// The sprites, and the atlas that holds them.
+	Atlas atlas;
 	Sprite border[9];
 	Sprite tile[16];
 	Sprite counter[10];
 	Sprite smiley[5];
 	Sprite frame;
 
+	// The tile sprites, uploaded as a texture atlas.
+	TextureAtlas tile_atlas;
+
+	// The tile of each visible cell in this frame and in the last frame,
+	// and the view they were drawn with. A tile that didn't change since the
+	// last frame is not drawn again.
+	struct TileView {
+		int camera_x;
+		int camera_y;
+		int cell_size;
+		int y0;
+
+		bool operator==(const TileView& other) const {
+			return camera_x == other.camera_x && camera_y == other.camera_y && cell_size == other.cell_size;
+		}
+	} tile_view = {0, 0, 0, 0};
+	std::vector<Uint8> tiles;
+	std::vector<Uint8> drawn_tiles;
+
+	// The cell drawn pressed in this frame, or -1.
+	int pressed_x = -1;
+	int pressed_y = -1;
+
+	// The flag counter and the timer, and whether the border they sit on is
+	// in the video memory, and the smiley in the video memory.
+	DigitDisplay flag_display;
+	DigitDisplay timer_display;
+	bool border_drawn = false;
+	int drawn_smiley = -1;
+
+	// The pens of the level-of-detail codes (see Graphics::pen()).
+	Uint32 lod_pens[LOD_CODES];
+
 	// The game's settings.
-	int x_cells;
-	int y_cells;
-	int mines;
+	int x_cells = 0;
+	int y_cells = 0;
+	int mines = 0;
 
 	// The game's state.
 	enum {
 		GAME_WAITING,
 		GAME_PLAYING,
 		GAME_WINNER,
-		GAME_LOSER
-	} state;
+		GAME_LOSER,
+		GAME_STATES
+	} state = GAME_WAITING;
 	Uint32 start_ticks = 0;
 	Uint32 end_ticks = 0;
+	// The time of the action being performed.
+	Uint32 action_ticks = 0;
 	int flags;
+	// The number of uncovered cells without a mine.
+	Sint64 uncovered_cells = 0;
+
+	// The mouse coordinates.
+	int mouse_x = 0;
+	int mouse_y = 0;
+
+	// The mouse state.
+	bool mouse_l = false;
+	bool mouse_r = false;
+	bool mouse_al = false;
+	bool mouse_ar = false;
+	bool mouse_minimap = false;
 
 	// The game board's render offset.
 	const int xoff = 10;
 	const int yoff = 50;
 
+	// The game board's viewport, in video memory pixels.
+	int view_x_res;
+	int view_y_res;
+
+	// The camera. The camera's position is the offset of the viewport into
+	// the game board, in video memory pixels at the current zoom. Cells are
+	// cell_size pixels wide, and when zoomed out further each pixel covers a
+	// block of 2^block_shift by 2^block_shift cells.
+	int camera_x = 0;
+	int camera_y = 0;
+	int cell_size = 16;
+	int block_shift = 0;
+	const int max_cell_size = 64;
+
+	// Cells smaller than this are drawn with level-of-detail codes instead of
+	// tiles.
+	const int min_tile_size = 8;
+
 	// Default constructor.
-	Minesweeper(int x_cells, int y_cells, int mines) {
+	Minesweeper(int x_cells, int y_cells, int mines, Options options = Options()): pool(options.threads), pacer(options.fps) {
+		// Batched geometry needs a renderer.
+		if (options.headless) {
+			options.geometry = false;
+		}
+		this->options = options;
+		seeds = Random(options.seed);
+		// Video is copied from the video memory, which doesn't hold the board
+		// drawn as geometry.
+		if (options.geometry && !options.video.empty()) {
+			fprintf(stderr, "Video can't be recorded with --geometry.\n");
+			exit(EXIT_FAILURE);
+		}
+		// A saved game brings its own settings.
+		SaveGame saved;
+		if (!options.load.empty()) {
+			if (!saved.read(options.load) || saved.state >= GAME_STATES) {
+				fprintf(stderr, "Could not load \"%s\".\n", options.load.c_str());
+				exit(EXIT_FAILURE);
+			}
+			x_cells = saved.x_cells;
+			y_cells = saved.y_cells;
+			mines = saved.mines;
+		}
+		// So does an existing board file. The minimap would need memory for
+		// every cell, so it is left out.
+		bool board_exists = false;
+		if (!options.board_file.empty()) {
+			if (!options.load.empty()) {
+				fprintf(stderr, "A saved game can't be loaded into a board file.\n");
+				exit(EXIT_FAILURE);
+			}
+			track_minimap = false;
+			show_minimap = false;
+			board_exists = open_board(options.board_file, x_cells, y_cells, mines);
+		}
+		// An unfinished game of the same mode in the journal is resumed.
+		JournalGame journalled;
+		bool resuming = false;
+		if (!options.headless && !options.journal.empty() && options.resume && options.load.empty() && options.board_file.empty()) {
+			resuming = journalled.read(options.journal) && !journalled.finished &&
+					   (!journalled.snapshot || journalled.saved.state < GAME_STATES) &&
+					   journalled.start.x_cells == x_cells && journalled.start.y_cells == y_cells &&
+					   journalled.start.mines == mines;
+		}
+		// Size the viewport to fit the game board, up to a limit.
+		view_x_res = std::min(x_cells * 16, options.view_x_res);
+		view_y_res = std::min(y_cells * 16, options.view_y_res);
+		// Start loading the sprite sheets, so that decoding them overlaps
+		// with creating the window.
+		std::vector<std::future<Sprite>> sheets = load_sheets();
 		// Create the graphics adapter.
-		adapter = Graphics("Minesweeper", x_cells * 16 + xoff + 10, y_cells * 16 + yoff + 10, 2);
+		Uint64 begin = timeline.now();
+		if (options.headless) {
+			adapter = Graphics(view_x_res + xoff + 10, view_y_res + yoff + 10);
+		} else {
+			adapter = Graphics("Minesweeper", view_x_res + xoff + 10, view_y_res + yoff + 10, 2, options.vsync);
+		}
+		if (options.indexed) {
+			adapter.use_indexed_color();
+		}
+		if (options.lock_texture) {
+			adapter.use_locked_texture();
+		}
+		timeline.add("Create the graphics adapter", begin);
+		// Screenshots are copied from the video memory too.
+		if (!adapter.headless() && !options.geometry) {
+			screenshots.reset(new ScreenshotWriter(size_t(adapter.x_res) * adapter.y_res));
+		}
+		if (!adapter.headless() && !options.stats_file.empty()) {
+			begin = timeline.now();
+			stats.reset(new StatsStore(options.stats_file));
+			if (!stats->is_valid()) {
+				fprintf(stderr, "\"%s\" is not a statistics file, so games won't be recorded.\n", options.stats_file.c_str());
+			}
+			timeline.add("Load the statistics", begin);
+		}
+		if (!options.video.empty()) {
+			video_writer.reset(new VideoWriter(options.video, adapter.x_res, adapter.y_res));
+			if (!video_writer->is_open()) {
+				fprintf(stderr, "Could not write \"%s\".\n", options.video.c_str());
+				exit(EXIT_FAILURE);
+			}
+		}
 		// Load the sprites.
-		load_borders();
-		load_tiles();
-		load_counters();
-		load_smileys();
-		load_frame();
+		load_sprites(sheets);
+		for (int code = 0; code < LOD_CODES; code++) {
+			lod_pens[code] = adapter.pen(lod_color(code));
+		}
+		// Upload the tile sprites. They are packed one after another, so
+		// they form a 16 pixel wide strip.
+		if (options.geometry) {
+			tile_atlas = adapter.create_atlas(Sprite(tile[0].data, 16, 16 * 16));
+		}
 		// Allocate the game board.
-		this->x_cells = x_cells;
-		this->y_cells = y_cells;
-		this->mines = mines;
-		board = new Cell[x_cells * y_cells];
-		// Generate the game board.
-		generate_board();
+		resize(x_cells, y_cells, mines);
+		timer_display = DigitDisplay(3, frame, counter);
+		// Start recording.
+		if (!options.record.empty()) {
+			recorder.reset(new ReplayWriter(options.record));
+			if (!recorder->is_open()) {
+				fprintf(stderr, "Could not write \"%s\".\n", options.record.c_str());
+				exit(EXIT_FAILURE);
+			}
+		}
+		// Generate the game board, or restore the saved one.
+		if (board_exists) {
+			clamp_camera();
+		} else if (resuming) {
+			if (resume(journalled)) {
+				printf("Resumed the game journalled in \"%s\"\n", options.journal.c_str());
+			} else {
+				restart();
+			}
+		} else if (options.load.empty()) {
+			restart();
+		} else {
+			load(saved);
+		}
+		// Start journalling.
+		if (!options.headless && !options.journal.empty() && options.board_file.empty()) {
+			journal.reset(new Journal(options.journal));
+			journal_game();
+		}
+	}
+
+	// Load a sprite sheet, either from the theme directory or from the sheets
+	// built into the executable. Sheets in the theme directory are decoded on
+	// their own thread.
+	std::future<Sprite> load_sheet(std::string filename, const EmbeddedSheet& embedded) {
+		if (options.theme.empty()) {
+			std::promise<Sprite> sheet;
+			sheet.set_value(Sprite(embedded));
+			return sheet.get_future();
+		}
+		std::string path = options.theme + "/" + filename;
+		return std::async(std::launch::async, [this, path, filename] {
+			Uint64 begin = timeline.now();
+			Sprite sheet(path);
+			timeline.add("Decode " + filename, begin);
+			return sheet;
+		});
+	}
+
+	// Start loading every sprite sheet.
+	std::vector<std::future<Sprite>> load_sheets() {
+		std::vector<std::future<Sprite>> sheets;
+		sheets.push_back(load_sheet("Border.png", border_png));
+		sheets.push_back(load_sheet("Tile.png", tile_png));
+		sheets.push_back(load_sheet("Counter.png", counter_png));
+		sheets.push_back(load_sheet("Smiley.png", smiley_png));
+		sheets.push_back(load_sheet("Frame.png", frame_png));
+		return sheets;
+	}
+
+	// Wait for the sprite sheets and load every sprite into the atlas. Exits
+	// if a sheet couldn't be loaded, once every sheet is done.
+	void load_sprites(std::vector<std::future<Sprite>>& loading) {
+		Uint64 begin = timeline.now();
+		Sprite sheets[5];
+		bool loaded = true;
+		for (int i = 0; i < 5; i++) {
+			sheets[i] = loading[i].get();
+			loaded = loaded && sheets[i].data;
+		}
+		if (!loaded) {
+			exit(EXIT_FAILURE);
+		}
+		timeline.add("Wait for the sprite sheets", begin);
+		begin = timeline.now();
+		load_borders(sheets[0]);
+		load_tiles(sheets[1]);
+		load_counters(sheets[2]);
+		load_smileys(sheets[3]);
+		load_frame(sheets[4]);
+		atlas.pack(options.indexed ? &adapter.palette : nullptr);
+		timeline.add("Pack the atlas", begin);
 	}
 
 	// Load the border sprites.
-	void load_borders() {
-		Sprite sheet("Border.png");
+	void load_borders(const Sprite& sheet) {
 		for (int i = 0; i < 9; i++) {
-			border[i] = Sprite(sheet, i * 10, 0, 10, 10);
+			atlas.add(sheet, i * 10, 0, 10, 10, &border[i]);
 		}
 	}
 
 	// Load the tile sprites.
-	void load_tiles() {
-		Sprite sheet("Tile.png");
+	void load_tiles(const Sprite& sheet) {
 		for (int i = 0; i < 8; i++) {
-			tile[i] = Sprite(sheet, i * 16, 0, 16, 16);
+			atlas.add(sheet, i * 16, 0, 16, 16, &tile[i]);
 		}
 		for (int i = 0; i < 8; i++) {
-			tile[i + 8] = Sprite(sheet, i * 16, 16, 16, 16);
+			atlas.add(sheet, i * 16, 16, 16, 16, &tile[i + 8]);
 		}
 	}
 
 	// Load the counter sprites.
-	void load_counters() {
-		Sprite sheet("Counter.png");
+	void load_counters(const Sprite& sheet) {
 		for (int i = 0; i < 10; i++) {
-			counter[i] = Sprite(sheet, i * 13, 0, 13, 23);
+			atlas.add(sheet, i * 13, 0, 13, 23, &counter[i]);
 		}
 	}
 
 	// Load the smiley sprites.
-	void load_smileys() {
-		Sprite sheet("Smiley.png");
+	void load_smileys(const Sprite& sheet) {
 		for (int i = 0; i < 5; i++) {
-			smiley[i] = Sprite(sheet, i * 26, 0, 26, 26);
+			atlas.add(sheet, i * 26, 0, 26, 26, &smiley[i]);
 		}
 	}
 
 	// Load the frame sprite.
-	void load_frame() {
-		frame = Sprite("Frame.png");
+	void load_frame(const Sprite& sheet) {
+		atlas.add(sheet, 0, 0, sheet.x_res, sheet.y_res, &frame);
+	}
+
+	// The index of a cell.
+	inline size_t index(int x, int y) {
+		return size_t(y) * x_cells + x;
 	}
 
 	// Check if a coordinate is within the bounds of the game board.
@@ -142,57 +535,436 @@ public:
 			   y >= 0 && y < y_cells;
 	}
 
-	// Generate the game board.
-	void generate_board() {
-		flags = 0;
-		// Clear the game board.
+	// Find the cell under a point of the video memory. Returns false if the
+	// point is not over a single cell of the game board, and the cell is then
+	// (-1, -1).
+	bool pick(int x, int y, int& cell_x, int& cell_y) {
+		cell_x = -1;
+		cell_y = -1;
+		if (x < xoff || x >= xoff + view_x_res ||
+			y < yoff || y >= yoff + view_y_res) {
+			return false;
+		}
+		SDL_Rect inset;
+		int level;
+		if (block_shift > 0 || (minimap_rect(inset, level) && is_inside(inset, x, y))) {
+			return false;
+		}
+		int i = (x - xoff + camera_x) / cell_size;
+		int j = (y - yoff + camera_y) / cell_size;
+		if (!is_bound(i, j)) {
+			return false;
+		}
+		cell_x = i;
+		cell_y = j;
+		return true;
+	}
+
+	// Check if a point lies within a rectangle.
+	inline bool is_inside(SDL_Rect r, int x, int y) {
+		return x >= r.x && x < r.x + r.w &&
+			   y >= r.y && y < r.y + r.h;
+	}
+
+	// The number of video memory pixels per cell at the current zoom.
+	inline double pixels_per_cell() {
+		return double(cell_size) / (1 << block_shift);
+	}
+
+	// The size of the game board in video memory pixels at the current zoom.
+	inline int board_x_res() {
+		return block_shift ? (x_cells + (1 << block_shift) - 1) >> block_shift : x_cells * cell_size;
+	}
+	inline int board_y_res() {
+		return block_shift ? (y_cells + (1 << block_shift) - 1) >> block_shift : y_cells * cell_size;
+	}
+
+	// Check if the board is drawn with level-of-detail codes.
+	inline bool is_lod() {
+		return block_shift > 0 || cell_size < min_tile_size;
+	}
+
+	// Keep the camera within the game board.
+	void clamp_camera() {
+		camera_x = std::max(0, std::min(camera_x, board_x_res() - view_x_res));
+		camera_y = std::max(0, std::min(camera_y, board_y_res() - view_y_res));
+	}
+
+	// Zoom in (steps > 0) or out (steps < 0) by a factor of two, keeping the
+	// point of the game board under a point of the viewport in place. Zooming
+	// out stops once the whole game board fits in the viewport.
+	void zoom(int steps, int x, int y) {
+		int u = x - xoff;
+		int v = y - yoff;
+		double cell_x = (camera_x + u) / pixels_per_cell();
+		double cell_y = (camera_y + v) / pixels_per_cell();
+		if (steps > 0) {
+			if (block_shift > 0) {
+				block_shift--;
+			} else if (cell_size < max_cell_size) {
+				cell_size *= 2;
+			}
+		} else if (steps < 0 && (track_minimap || cell_size > min_tile_size)) {
+			// Cells smaller than tiles are drawn from the level-of-detail
+			// codes, so they need the minimap.
+			if (cell_size > 1) {
+				cell_size /= 2;
+			} else if (board_x_res() > view_x_res || board_y_res() > view_y_res) {
+				block_shift++;
+			}
+		}
+		camera_x = int(cell_x * pixels_per_cell()) - u;
+		camera_y = int(cell_y * pixels_per_cell()) - v;
+		clamp_camera();
+	}
+
+	// Find the minimap inset and the level of detail it shows. Returns false
+	// if the minimap is hidden.
+	bool minimap_rect(SDL_Rect& inset, int& level) {
+		if (!show_minimap || (board_x_res() <= view_x_res && board_y_res() <= view_y_res)) {
+			return false;
+		}
+		level = 0;
+		while (minimap.width(level) > minimap_size || minimap.height(level) > minimap_size) {
+			level++;
+		}
+		inset.w = minimap.width(level);
+		inset.h = minimap.height(level);
+		inset.x = xoff + view_x_res - inset.w - 4;
+		inset.y = yoff + view_y_res - inset.h - 4;
+		return inset.x >= xoff + 4 && inset.y >= yoff + 4;
+	}
+
+	// Zoom out until the whole game board fits in the viewport.
+	void fit() {
+		while (board_x_res() > view_x_res || board_y_res() > view_y_res) {
+			int x_res = board_x_res();
+			zoom(-1, xoff, yoff);
+			if (board_x_res() == x_res) {
+				break;
+			}
+		}
+	}
+
+	// Center the camera on the cell under a point of the minimap.
+	void jump(int x, int y) {
+		SDL_Rect inset;
+		int level;
+		if (minimap_rect(inset, level)) {
+			double cell_x = double(std::max(0, std::min(x - inset.x, inset.w - 1)) << level);
+			double cell_y = double(std::max(0, std::min(y - inset.y, inset.h - 1)) << level);
+			camera_x = int(cell_x * pixels_per_cell()) - view_x_res / 2;
+			camera_y = int(cell_y * pixels_per_cell()) - view_y_res / 2;
+			clamp_camera();
+		}
+	}
+
+	// Update the level-of-detail code of a cell.
+	inline void update_minimap(int x, int y) {
+		if (!track_minimap) {
+			return;
+		}
+		minimap.set(x, y, lod_code(classify(board[index(x, y)])));
+	}
+
+	// Recompute the level-of-detail codes of every cell. This is needed when
+	// the game's state changes, as that changes how mines are drawn.
+	void rebuild_minimap() {
+		if (!track_minimap) {
+			return;
+		}
 		for (int y = 0; y < y_cells; y++) {
 			for (int x = 0; x < x_cells; x++) {
-				Cell& cell = board[y * x_cells + x];
-				cell.neighbours = 0;
-				cell.is_uncovered = false;
-				cell.is_flagged = false;
-				cell.is_mine = false;
-				cell.is_culprit = false;
+				minimap.set_base(x, y, lod_code(classify(board[index(x, y)])));
 			}
 		}
+		minimap.build();
+	}
+
+	// Generate the game board from its seed. Every cell is written, even
+	// those of a chunked board file, which therefore has to fit in memory
+	// while it is generated.
+	void generate_board() {
+		flags = 0;
+		clicks = 0;
+		uncovered_cells = 0;
+		random = Random(seed);
+		// Clear the game board.
+		std::fill(board.begin(), board.end(), Cell());
+		board.touch_all();
 		// Add some mines.
 		for (int i = 0; i < mines; i++) {
 			while (1) {
-				int x = rand() % x_cells;
-				int y = rand() % y_cells;
-				Cell& cell = board[y * x_cells + x];
-				if (!cell.is_mine) {
-					cell.is_mine = true;
+				int x = random.below(x_cells);
+				int y = random.below(y_cells);
+				Cell& cell = board[index(x, y)];
+				if (!cell.is_mine()) {
+					cell.set(CELL_MINE, true);
 					break;
 				}
 			}
 		}
 		// Calculate the neighbouring mine count of each cell.
 		calculate_neighbours();
+		rebuild_minimap();
+	}
+
+	// Resize the game board and everything that depends on its size. The
+	// cells are left to be generated or restored.
+	void resize(int x_cells, int y_cells, int mines) {
+		wait_stats();
+		if (x_cells != this->x_cells || y_cells != this->y_cells) {
+			this->x_cells = x_cells;
+			this->y_cells = y_cells;
+			// A mapped board is sized by its file.
+			if (!board.is_mapped()) {
+				board.resize(size_t(x_cells) * y_cells);
+			}
+			minimap = track_minimap ? Minimap(x_cells, y_cells) : Minimap();
+			clamp_camera();
+			invalidate();
+		}
+		if (mines != this->mines || flag_display.max() == 0) {
+			this->mines = mines;
+			flag_display = DigitDisplay(std::max(3, DigitDisplay::digits_of(mines)), frame, counter);
+		}
+	}
+
+	// Restart the game with a new game board.
+	void restart() {
+		restart(seeds.next());
+	}
+
+	// Restart the game with the game board of a seed.
+	void restart(Uint64 seed) {
+		wait_stats();
+		state = GAME_WAITING;
+		start_ticks = 0;
+		end_ticks = 0;
+		this->seed = seed;
+		generate_board();
+		if (recorder) {
+			recorder->game(x_cells, y_cells, mines, seed, SDL_GetTicks());
+		}
+		recording = true;
+		journal_game();
+	}
+
+	// Start the journal over with the current game: a new game from its seed,
+	// or a snapshot of the game.
+	void journal_game() {
+		if (!journal) {
+			return;
+		}
+		Uint32 ticks = SDL_GetTicks();
+		if (recording && state == GAME_WAITING) {
+			journal->game(x_cells, y_cells, mines, seed, ticks);
+		} else {
+			const Uint8* bytes = &board[0].bits;
+			journal->snapshot(save_state(), std::vector<Uint8>(bytes, bytes + board.size()), ticks);
+		}
+	}
+
+	// Resume the game of a journal where its last action left it, as if the
+	// time since then hadn't passed. A game resumed from its seed is recorded
+	// as it was played; one resumed from a snapshot, like a loaded game,
+	// isn't. Returns false if the game ended.
+	bool resume(const JournalGame& journalled) {
+		// The journal's times, moved to end now.
+		Uint32 shift = SDL_GetTicks() - journalled.ticks;
+		if (journalled.snapshot) {
+			load(journalled.saved);
+			if (state == GAME_PLAYING) {
+				start_ticks = journalled.start.ticks + shift - journalled.saved.elapsed;
+			}
+		} else {
+			restart(journalled.start.seed);
+		}
+		// A game that ended before the journal said so was already counted.
+		wait_stats();
+		std::unique_ptr<StatsStore> counted = std::move(stats);
+		for (const ReplayRecord& record: journalled.actions) {
+			act(record.kind, record.cell, record.ticks + shift);
+		}
+		stats = std::move(counted);
+		return state == GAME_WAITING || state == GAME_PLAYING;
 	}
 
-	// Calculate the neighbouring mine count of each cell.
+	// Calculate the neighbouring mine count of each cell. The mines of each
+	// column of three rows are kept as running sums, so that each row is
+	// added and removed once and each cell only adds up three columns.
 	void calculate_neighbours() {
+		std::vector<Uint8> columns(x_cells + 2, 0);
+		add_mines(columns, 0, 1);
 		for (int y = 0; y < y_cells; y++) {
+			if (y + 1 < y_cells) {
+				add_mines(columns, y + 1, 1);
+			}
+			if (y - 2 >= 0) {
+				add_mines(columns, y - 2, -1);
+			}
+			Cell* row = board.data() + index(0, y);
 			for (int x = 0; x < x_cells; x++) {
-				Cell& cell = board[y * x_cells + x];
-				cell.neighbours = 0;
-				for (int v = 0; v < 3; v++) {
-					for (int u = 0; u < 3; u++) {
-						int i = x - 1 + u;
-						int j = y - 1 + v;
-						if (is_bound(i, j)) {
-							if (board[j * x_cells + i].is_mine) {
-								cell.neighbours++;
-							}
-						}
-					}
-				}
+				row[x].set_neighbours(columns[x] + columns[x + 1] + columns[x + 2]);
 			}
 		}
 	}
 
+	// Add (or with a sign of -1, remove) the mines of a row to the column
+	// sums.
+	void add_mines(std::vector<Uint8>& columns, int y, int sign) {
+		const Uint8* row = &board[index(0, y)].bits;
+		Uint8* sums = columns.data() + 1;
+		for (int x = 0; x < x_cells; x++) {
+			sums[x] += sign * ((row[x] & CELL_MINE) != 0);
+		}
+	}
+
+	// The milliseconds the game has been played for.
+	Uint32 elapsed() {
+		if (state == GAME_PLAYING) {
+			return SDL_GetTicks() - start_ticks;
+		} else if (state != GAME_WAITING) {
+			return end_ticks - start_ticks;
+		}
+		return 0;
+	}
+
+	// Open a board file and read the settings and state of the game kept in
+	// it, or create one for the settings if it doesn't exist. Returns true if
+	// it holds a game board, and false if the game board is still to be
+	// generated, and exits if it can't be opened or created.
+	bool open_board(std::string filename, int& x_cells, int& y_cells, int& mines) {
+		if (board.open(filename)) {
+			Reader in(board.header(), Board::HEADER_SIZE);
+			const Uint8* magic = in.skip(8);
+			bool valid = memcmp(magic, "MSWPBORD", 8) == 0 && in.le(4) == BOARD_VERSION;
+			x_cells = in.le(4);
+			y_cells = in.le(4);
+			mines = in.le(4);
+			seed = in.le(8);
+			random.state = in.le(8);
+			int saved_state = in.le(1);
+			Uint32 played = in.le(4);
+			flags = in.le(8);
+			uncovered_cells = in.le(8);
+			if (!valid || x_cells <= 0 || y_cells <= 0 || x_cells > Board::MAX_SIDE || y_cells > Board::MAX_SIDE ||
+				board.size() != size_t(x_cells) * y_cells || saved_state >= GAME_STATES) {
+				fprintf(stderr, "\"%s\" is not a board file.\n", filename.c_str());
+				exit(EXIT_FAILURE);
+			}
+			// A file created by a game that ended before its board was
+			// generated (see below).
+			if (random.state == 0) {
+				return false;
+			}
+			// Keep the clock running from where it was.
+			state = decltype(state)(saved_state);
+			end_ticks = SDL_GetTicks();
+			start_ticks = state == GAME_WAITING ? 0 : end_ticks - played;
+			return true;
+		}
+		struct stat status;
+		if (stat(filename.c_str(), &status) == 0 || x_cells > Board::MAX_SIDE || y_cells > Board::MAX_SIDE ||
+			!(options.chunked ? board.create_chunked(filename, x_cells, y_cells) : board.create(filename, size_t(x_cells) * y_cells))) {
+			fprintf(stderr, "Could not open \"%s\".\n", filename.c_str());
+			exit(EXIT_FAILURE);
+		}
+		// Write the settings to the new file at once, so that it can be
+		// opened again whenever the game ends. A random state of zero, which
+		// the generator never has, marks the board as not generated yet.
+		std::vector<Uint8> header;
+		put_board_header(header, x_cells, y_cells, mines, 0, 0, GAME_WAITING, 0, 0, 0);
+		memcpy(board.header(), header.data(), header.size());
+		board.flush();
+		return false;
+	}
+
+	// Put the header of a board file.
+	static void put_board_header(std::vector<Uint8>& out, int x_cells, int y_cells, int mines, Uint64 seed, Uint64 random,
+								 int state, Uint32 played, Uint64 flags, Uint64 uncovered_cells) {
+		const char* magic = "MSWPBORD";
+		out.insert(out.end(), magic, magic + 8);
+		put_le(out, BOARD_VERSION, 4);
+		put_le(out, x_cells, 4);
+		put_le(out, y_cells, 4);
+		put_le(out, mines, 4);
+		put_le(out, seed, 8);
+		put_le(out, random, 8);
+		put_le(out, state, 1);
+		put_le(out, played, 4);
+		put_le(out, flags, 8);
+		put_le(out, uncovered_cells, 8);
+	}
+
+	// Write the game's state to the header of its board file, and the
+	// changed cells back to the file.
+	void flush_board() {
+		if (!board.is_mapped()) {
+			return;
+		}
+		std::vector<Uint8> header;
+		put_board_header(header, x_cells, y_cells, mines, seed, random.state, state, elapsed(), flags, uncovered_cells);
+		memcpy(board.header(), header.data(), header.size());
+		board.flush();
+	}
+
+	// Save the game's settings and state, without its cells.
+	SaveGame save_state() {
+		SaveGame saved;
+		saved.x_cells = x_cells;
+		saved.y_cells = y_cells;
+		saved.mines = mines;
+		saved.seed = seed;
+		saved.random = random.state;
+		saved.state = state;
+		saved.elapsed = elapsed();
+		return saved;
+	}
+
+	// Save the game.
+	SaveGame save() {
+		SaveGame saved = save_state();
+		pack_cells(saved, &board[0].bits, board.size());
+		return saved;
+	}
+
+	// Restore a saved game. The game board is resized to fit it.
+	void load(const SaveGame& saved) {
+		wait_stats();
+		resize(saved.x_cells, saved.y_cells, saved.mines);
+		seed = saved.seed;
+		random.state = saved.random;
+		state = decltype(state)(saved.state);
+		recording = false;
+
+		// Restore the cells.
+		std::fill(board.begin(), board.end(), Cell());
+		Uint8* bytes = &board[0].bits;
+		size_t cells = board.size();
+		unpack_plane(saved.mine, bytes, cells, CELL_MINE);
+		unpack_plane(saved.uncovered, bytes, cells, CELL_UNCOVERED);
+		unpack_plane(saved.flagged, bytes, cells, CELL_FLAGGED);
+		if (saved.culprit >= 0) {
+			board[saved.culprit].set(CELL_CULPRIT, true);
+		}
+		calculate_neighbours();
+		flags = plane_count(saved.flagged);
+		uncovered_cells = 0;
+		for (size_t i = 0; i < saved.uncovered.size(); i++) {
+			uncovered_cells += count_bits(saved.uncovered[i] & ~saved.mine[i]);
+		}
+
+		// Keep the clock running from where it was.
+		end_ticks = SDL_GetTicks();
+		start_ticks = state == GAME_WAITING ? 0 : end_ticks - saved.elapsed;
+
+		rebuild_minimap();
+		clamp_camera();
+		invalidate();
+		journal_game();
+	}
+
 	// Divert a cell and it's neighbours so that there are no mines in the
 	// neighbourhood of a cell.
 	void divert(int x, int y) {
@@ -202,18 +974,18 @@ public:
 				int i = x - 1 + u;
 				int j = y - 1 + v;
 				if (is_bound(i, j)) {
-					Cell& cell = board[j * x_cells + i];
-					if (cell.is_mine) {
+					Cell& cell = board[index(i, j)];
+					if (cell.is_mine()) {
 						// Divert this mine.
 						while (1) {
 							// Pick a random position for the mine.
-							int n = rand() % x_cells;
-							int m = rand() % y_cells;
+							int n = random.below(x_cells);
+							int m = random.below(y_cells);
 							if (is_bound(n, m)) {
-								Cell& cell = board[m * x_cells + n];
+								Cell& cell = board[index(n, m)];
 								// Check if the cell at the new position is
 								// already a mine.
-								if (cell.is_mine) {
+								if (cell.is_mine()) {
 									continue;
 								}
 								// Check if the new position lies within the
@@ -223,30 +995,34 @@ public:
 								{
 									continue;
 								}
-								cell.is_mine = true;
+								cell.set(CELL_MINE, true);
+								count_mine(n, m, 1);
 								break;
 							}
 						}
-						cell.is_mine = false;
+						cell.set(CELL_MINE, false);
+						count_mine(i, j, -1);
 					}
 				}
 			}
 		}
-		// Calculate the neighbouring mine count of each cell.
-		calculate_neighbours();
 	}
 
-	// Check if all non-mine cells have been uncovered.
-	bool winner() {
-		for (int y = 0; y < y_cells; y++) {
-			for (int x = 0; x < x_cells; x++) {
-				Cell& cell = board[y * x_cells + x];
-				if (!cell.is_mine && !cell.is_uncovered) {
-					return false;
-				}
+	// Add a mine (count 1) or remove one (count -1) from the neighbouring
+	// mine counts of the cells around it, including its own.
+	void count_mine(int x, int y, int count) {
+		for (int j = std::max(0, y - 1); j <= std::min(y_cells - 1, y + 1); j++) {
+			for (int i = std::max(0, x - 1); i <= std::min(x_cells - 1, x + 1); i++) {
+				Cell& cell = board[index(i, j)];
+				cell.set_neighbours(cell.neighbours() + count);
+				board.touch(index(i, j));
 			}
 		}
-		return true;
+	}
+
+	// Check if all non-mine cells have been uncovered.
+	bool winner() {
+		return uncovered_cells == Sint64(x_cells) * y_cells - mines;
 	}
 
 	// Uncover a cell.
@@ -259,31 +1035,57 @@ public:
 		if (!is_bound(x, y)) {
 			return;
 		}
-		Cell& cell = board[y * x_cells + x];
-		if (!cell.is_uncovered) {
+		Cell& cell = board[index(x, y)];
+		if (!cell.is_uncovered()) {
 			// A cell is being uncovered.
 			if (state == GAME_WAITING) {
 				state = GAME_PLAYING;
-				start_ticks = SDL_GetTicks();
+				start_ticks = action_ticks;
 				// Divert mines away from the first click.
 				divert(x, y);
 			}
-			cell.is_uncovered = true;
-			if (cell.is_mine) {
+			cell.set(CELL_UNCOVERED, true);
+			board.touch(index(x, y));
+			if (cell.is_mine()) {
 				// The player uncovered a mine!
 				state = GAME_LOSER;
-				end_ticks = SDL_GetTicks();
-				cell.is_culprit = true;
-			} else if (cell.neighbours == 0) {
-				// Recursively uncover neighbouring cells.
-				uncover(x - 1, y    );
-				uncover(x + 1, y    );
-				uncover(x    , y - 1);
-				uncover(x    , y + 1);
-				uncover(x - 1, y - 1);
-				uncover(x - 1, y + 1);
-				uncover(x + 1, y - 1);
-				uncover(x + 1, y + 1);
+				end_ticks = action_ticks;
+				cell.set(CELL_CULPRIT, true);
+				rebuild_minimap();
+				return;
+			}
+			uncovered_cells++;
+			update_minimap(x, y);
+			if (cell.neighbours() == 0) {
+				flood(x, y);
+			}
+		}
+	}
+
+	// Uncover the neighbours of an empty cell, and the neighbours of every
+	// empty cell uncovered along the way. The cells still to visit are kept
+	// on a stack rather than recursed into, as a reveal can span millions of
+	// cells. None of them can be a mine.
+	void flood(int x, int y) {
+		std::vector<std::pair<int, int>> stack(1, std::make_pair(x, y));
+		while (!stack.empty()) {
+			int cx = stack.back().first;
+			int cy = stack.back().second;
+			stack.pop_back();
+			for (int j = std::max(0, cy - 1); j <= std::min(y_cells - 1, cy + 1); j++) {
+				for (int i = std::max(0, cx - 1); i <= std::min(x_cells - 1, cx + 1); i++) {
+					Cell& cell = board[index(i, j)];
+					if (cell.is_uncovered()) {
+						continue;
+					}
+					cell.set(CELL_UNCOVERED, true);
+					board.touch(index(i, j));
+					uncovered_cells++;
+					update_minimap(i, j);
+					if (cell.neighbours() == 0) {
+						stack.push_back(std::make_pair(i, j));
+					}
+				}
 			}
 		}
 	}
@@ -298,18 +1100,20 @@ public:
 		if (!is_bound(x, y)) {
 			return;
 		}
-		Cell& cell = board[y * x_cells + x];
-		if (!cell.is_uncovered) {
+		Cell& cell = board[index(x, y)];
+		if (!cell.is_uncovered()) {
 			if (state == GAME_WAITING) {
 				state = GAME_PLAYING;
-				start_ticks = SDL_GetTicks();
+				start_ticks = action_ticks;
 			}
-			if (cell.is_flagged) {
+			if (cell.is_flagged()) {
 				flags--;
 			} else {
 				flags++;
 			}
-			cell.is_flagged = !cell.is_flagged;
+			cell.set(CELL_FLAGGED, !cell.is_flagged());
+			board.touch(index(x, y));
+			update_minimap(x, y);
 		}
 	}
 
@@ -317,27 +1121,128 @@ public:
 	void solve() {
 		for (int y = 0; y < y_cells; y++) {
 			for (int x = 0; x < x_cells; x++) {
-				Cell& cell = board[y * x_cells + x];
-				if (cell.is_mine) {
-					cell.is_flagged = true;
+				Cell& cell = board[index(x, y)];
+				if (cell.is_mine()) {
+					cell.set(CELL_FLAGGED, true);
 				} else {
-					cell.is_uncovered = true;
+					cell.set(CELL_UNCOVERED, true);
+				}
+			}
+		}
+		uncovered_cells = Sint64(x_cells) * y_cells - mines;
+		board.touch_all();
+		rebuild_minimap();
+	}
+
+	// Perform a player action of a replay record kind at a time, on the cell
+	// with an index, and record it.
+	void act(int action, Sint64 cell, Uint32 ticks) {
+		// Actions on a finished game do nothing, so they aren't recorded.
+		bool finished = state == GAME_WINNER || state == GAME_LOSER;
+		if (recorder && recording && !finished) {
+			recorder->action(action, cell, ticks);
+		}
+		if (journal && !finished) {
+			journal->action(action, cell, ticks);
+		}
+		action_ticks = ticks;
+		if (!finished && (action == REPLAY_UNCOVER || action == REPLAY_FLAG)) {
+			clicks++;
+		}
+		int x = cell % x_cells;
+		int y = cell / x_cells;
+		if (action == REPLAY_UNCOVER) {
+			uncover(x, y);
+			// Check if the player won.
+			if (winner() && state == GAME_PLAYING) {
+				state = GAME_WINNER;
+				end_ticks = ticks;
+				flags = mines;
+				rebuild_minimap();
+				if (!options.headless) {
+					printf("You swept a %dx%d field with %d mines in %.2f seconds\n", x_cells, y_cells, mines, float(end_ticks - start_ticks) / 1000.0f);
+				}
+			}
+		} else if (action == REPLAY_FLAG) {
+			flag(x, y);
+		} else if (action == REPLAY_SOLVE) {
+			if (state == GAME_PLAYING) {
+				state = GAME_WINNER;
+				solve();
+				end_ticks = ticks;
+				flags = mines;
+			}
+		}
+		// Record the result if the game ended.
+		if (recorder && recording && !finished && (state == GAME_WINNER || state == GAME_LOSER)) {
+			recorder->result(state == GAME_WINNER, end_ticks - start_ticks, ticks);
+		}
+		// Journal the result too, or start the journal over once its actions
+		// outweigh a snapshot.
+		if (journal && !finished && (state == GAME_WINNER || state == GAME_LOSER)) {
+			journal->result(state == GAME_WINNER, end_ticks - start_ticks, ticks);
+		} else if (journal && journal->is_due()) {
+			journal_game();
+		}
+		// Add the game to the statistics if it was played out from its seed.
+		if (stats && recording && !finished && action != REPLAY_SOLVE && (state == GAME_WINNER || state == GAME_LOSER)) {
+			add_stats();
+		}
+	}
+
+	// Add the game that just ended to the statistics. Its 3BV is counted and
+	// it is appended to the file on another thread, as both take time in
+	// proportion to the board and the disk.
+	void add_stats() {
+		GameResult result;
+		result.x_cells = x_cells;
+		result.y_cells = y_cells;
+		result.mines = mines;
+		result.won = state == GAME_WINNER;
+		result.elapsed = end_ticks - start_ticks;
+		result.clicks = clicks;
+		result.seed = seed;
+		result.time = time(NULL);
+		// Counting a mapped board would read all of it.
+		bool count = !board.is_mapped();
+		wait_stats();
+		adding_stats = std::async(std::launch::async, [this, result, count]() mutable {
+			if (count) {
+				result.bbbv = count_3bv(result.x_cells, result.y_cells,
+					[&](size_t c) { return board[c].is_mine(); },
+					[&](size_t c) { return board[c].neighbours(); },
+					bbbv_marks, bbbv_stack);
+			}
+			if (!stats->append(result)) {
+				if (stats->is_valid()) {
+					fprintf(stderr, "Could not write \"%s\".\n", options.stats_file.c_str());
 				}
+				return;
 			}
+			ModeStats* mode = stats->mode(result.x_cells, result.y_cells, result.mines);
+			if (result.won) {
+				printf("3BV %llu in %u clicks. Best time %.2f seconds, %llu wins in a row\n",
+					(unsigned long long)result.bbbv, result.clicks, mode->best / 1000.0, (unsigned long long)mode->streak);
+			}
+		});
+	}
+
+	// Wait for the last game to be added to the statistics.
+	void wait_stats() {
+		if (adding_stats.valid()) {
+			adding_stats.get();
 		}
 	}
 
 	// Start the game.
 	void start() {
-		// The mouse coordinates.
-		int mouse_x = 0;
-		int mouse_y = 0;
-
-		// The mouse state.
-		bool mouse_l = false;
-		bool mouse_r = false;
-		bool mouse_al = false;
-		bool mouse_ar = false;
+		// The benchmark state.
+		int frames = 0;
+		Uint64 benchmark_ticks = SDL_GetPerformanceCounter();
+		// Whether the first frame is yet to be shown.
+		bool first = true;
+		// Whether to export a screenshot of the next frame.
+		bool pending_export = false;
 
 		// Loop until the game is quit.
 		while (1) {
@@ -350,25 +1255,87 @@ public:
 					SDL_Keycode key = e.key.keysym.sym;
 					if (key == SDLK_s) {
 						// Solve the board.
-						if (state == GAME_PLAYING) {
-							solve();
-							state = GAME_WINNER;
-							end_ticks = SDL_GetTicks();
-							flags = mines;
-						}
+						act(REPLAY_SOLVE, 0, SDL_GetTicks());
 					} else if (key == SDLK_e) {
-						// Export a screenshot.
-						char export_path[20];
-						sprintf(export_path, "export%010ld.bmp", time(NULL));
-						adapter.save_bmp(export_path);
+						// Export a screenshot of the next frame.
+						if (screenshots) {
+							pending_export = true;
+						} else {
+							fprintf(stderr, "Screenshots can't be taken with --geometry.\n");
+						}
+					} else if (key == SDLK_LEFT) {
+						// Pan the camera by one cell, or by 16 pixels when
+						// cells are smaller than that.
+						camera_x -= std::max(cell_size, 16);
+						clamp_camera();
+					} else if (key == SDLK_RIGHT) {
+						camera_x += std::max(cell_size, 16);
+						clamp_camera();
+					} else if (key == SDLK_UP) {
+						camera_y -= std::max(cell_size, 16);
+						clamp_camera();
+					} else if (key == SDLK_DOWN) {
+						camera_y += std::max(cell_size, 16);
+						clamp_camera();
+					} else if (key == SDLK_EQUALS || key == SDLK_KP_PLUS) {
+						// Zoom in or out around the center of the viewport.
+						zoom(1, xoff + view_x_res / 2, yoff + view_y_res / 2);
+					} else if (key == SDLK_MINUS || key == SDLK_KP_MINUS) {
+						zoom(-1, xoff + view_x_res / 2, yoff + view_y_res / 2);
+					} else if (key == SDLK_m) {
+						// Show or hide the minimap.
+						show_minimap = !show_minimap;
+						invalidate_tiles();
+					} else if (key == SDLK_F5) {
+						// Quicksave the game, or write a board file back.
+						if (board.is_mapped()) {
+							flush_board();
+						} else if (!save().write("quicksave.msw")) {
+							fprintf(stderr, "Could not write \"quicksave.msw\".\n");
+						}
+					} else if (key == SDLK_F9) {
+						// Quickload the game.
+						SaveGame saved;
+						if (board.is_mapped()) {
+							fprintf(stderr, "A saved game can't be loaded into a board file.\n");
+						} else if (saved.read("quicksave.msw") && saved.state < GAME_STATES) {
+							load(saved);
+						} else {
+							fprintf(stderr, "Could not load \"quicksave.msw\".\n");
+						}
 					}
 				} else if (e.type == SDL_MOUSEMOTION) {
-					mouse_x = e.motion.x / adapter.scale;
-					mouse_y = e.motion.y / adapter.scale;
+					int new_mouse_x = e.motion.x / adapter.scale;
+					int new_mouse_y = e.motion.y / adapter.scale;
+					if (e.motion.state & SDL_BUTTON_MMASK) {
+						// Drag the camera with the middle mouse button.
+						camera_x -= new_mouse_x - mouse_x;
+						camera_y -= new_mouse_y - mouse_y;
+						clamp_camera();
+					}
+					mouse_x = new_mouse_x;
+					mouse_y = new_mouse_y;
+					if (mouse_minimap) {
+						// Drag the camera across the minimap.
+						jump(mouse_x, mouse_y);
+					}
+				} else if (e.type == SDL_MOUSEWHEEL) {
+					// Zoom in or out around the mouse.
+					if (e.wheel.y > 0) {
+						zoom(1, mouse_x, mouse_y);
+					} else if (e.wheel.y < 0) {
+						zoom(-1, mouse_x, mouse_y);
+					}
 				} else if (e.type == SDL_MOUSEBUTTONDOWN) {
-					int cell_x = (mouse_x - xoff) / 16;
-					int cell_y = (mouse_y - yoff) / 16;
-					if (is_bound(cell_x, cell_y) && mouse_y > yoff && mouse_x > xoff) {
+					int cell_x;
+					int cell_y;
+					SDL_Rect inset;
+					int level;
+					if (e.button.button == SDL_BUTTON_LEFT && minimap_rect(inset, level) && is_inside(inset, mouse_x, mouse_y)) {
+						// Move the camera to the point of the minimap.
+						mouse_minimap = true;
+						jump(mouse_x, mouse_y);
+					} else if (pick(mouse_x, mouse_y, cell_x, cell_y)) {
 						if (e.button.button == SDL_BUTTON_LEFT) {
 							mouse_l = true;
 						} else if (e.button.button == SDL_BUTTON_RIGHT) {
@@ -381,39 +1348,31 @@ public:
 						mouse_ar = true;
 					}
 				} else if (e.type == SDL_MOUSEBUTTONUP) {
-					int cell_x = (mouse_x - xoff) / 16;
-					int cell_y = (mouse_y - yoff) / 16;
+					int cell_x;
+					int cell_y;
+					bool picked = pick(mouse_x, mouse_y, cell_x, cell_y);
 					if (e.button.button == SDL_BUTTON_LEFT) {
 						if (mouse_l) {
 							// Uncover a cell if the mouse is within the game
 							// board's bounds.
-							if (is_bound(cell_x, cell_y) && mouse_y > yoff && mouse_x > xoff) {
-								uncover(cell_x, cell_y);
-							}
-							// Check if the player won.
-							if (winner() && state == GAME_PLAYING) {
-								state = GAME_WINNER;
-								end_ticks = SDL_GetTicks();
-								flags = mines;
-								printf("You swept a %dx%d field with %d mines in %.2f seconds\n", x_cells, y_cells, mines, float(end_ticks - start_ticks) / 1000.0f);
+							if (picked) {
+								act(REPLAY_UNCOVER, index(cell_x, cell_y), SDL_GetTicks());
 							}
 						} else if (mouse_al) {
 							// Restart the game if the smiley was pressed.
 							if (mouse_x >= adapter.x_res / 2 - 13 && mouse_x <= adapter.x_res / 2 + 13 && mouse_y > 12 && mouse_y <= 38) {
-								state = GAME_WAITING;
-								start_ticks = 0;
-								end_ticks = 0;
-								generate_board();
+								restart();
 							}
 						}
 						mouse_l = false;
 						mouse_al = false;
+						mouse_minimap = false;
 					} else if (e.button.button == SDL_BUTTON_RIGHT) {
 						if (mouse_r) {
 							// Flag or unflag a cell if the mouse is within
 							// the game board's bounds.
-							if (is_bound(cell_x, cell_y) && mouse_y > yoff && mouse_x > xoff) {
-								flag(cell_x, cell_y);
+							if (picked) {
+								act(REPLAY_FLAG, index(cell_x, cell_y), SDL_GetTicks());
 							}
 						}
 						mouse_r = false;
@@ -422,139 +1381,361 @@ public:
 				}
 			}
 
-			// Render the border.
-			for (int y = 0; y < yoff; y += 10) {
-				for (int x = 0; x < adapter.x_res; x += 10) {
-					adapter.draw_sprite(border[BORDER_SOLID], x, y);
+			// Render the frame.
+			render();
+			if (pending_export) {
+				if (!screenshots->capture(adapter)) {
+					fprintf(stderr, "Still writing the last screenshots, skipped this one.\n");
 				}
+				pending_export = false;
+			} else if (screenshots) {
+				screenshots->flush();
 			}
-			for (int x = 0; x < adapter.x_res; x += 10) {
-				adapter.draw_sprite(border[BORDER_X_SOLID], x, 0                 );
-				adapter.draw_sprite(border[BORDER_X_SOLID], x, yoff - 10         );
-				adapter.draw_sprite(border[BORDER_X_SOLID], x, adapter.y_res - 10);
-			}
-			for (int y = 0; y < adapter.y_res; y += 10) {
-				adapter.draw_sprite(border[BORDER_Y_SOLID], 0                 , y);
-				adapter.draw_sprite(border[BORDER_Y_SOLID], adapter.x_res - 10, y);
-			}
-			adapter.draw_sprite(border[BORDER_TOP_LEFT]    , 0                 , 0                 );
-			adapter.draw_sprite(border[BORDER_TOP_RIGHT]   , adapter.x_res - 10, 0                 );
-			adapter.draw_sprite(border[BORDER_BOTTOM_LEFT] , 0                 , adapter.y_res - 10);
-			adapter.draw_sprite(border[BORDER_BOTTOM_RIGHT], adapter.x_res - 10, adapter.y_res - 10);
-			adapter.draw_sprite(border[BORDER_JOINT_LEFT]  , 0                 , yoff - 10         );
-			adapter.draw_sprite(border[BORDER_JOINT_RIGHT] , adapter.x_res - 10, yoff - 10         );
-
-			// Render the flag counter.
-			char flag_counter_str[4];
-			sprintf(flag_counter_str, "%03d", std::max(0, mines - flags));
-			adapter.draw_sprite(frame, 16, 12);
-			for (int i = 0; i < 3; i++) {
-				adapter.draw_sprite(counter[flag_counter_str[i] - '0'], 18 + i * 13, 14);
-			}
-
-			// Render the timer.
-			char timer_str[4];
-			if (state == GAME_PLAYING) {
-				sprintf(timer_str, "%03d", std::min(999u, (SDL_GetTicks() - start_ticks) / 1000));
-			} else {
-				sprintf(timer_str, "%03d", std::min(999u, (end_ticks - start_ticks) / 1000));
+			if (video_writer) {
+				video_writer->capture(adapter, SDL_GetTicks());
+			}
+			if (recorder) {
+				recorder->flush();
 			}
-			adapter.draw_sprite(frame, adapter.x_res - 59, 12);
-			for (int i = 0; i < 3; i++) {
-				adapter.draw_sprite(counter[timer_str[i] - '0'], adapter.x_res - 57 + i * 13, 14);
+			if (journal) {
+				journal->flush();
 			}
 
-			// Render the smiley.
-			int smiley_type;
-			if (state == GAME_WINNER) {
-				smiley_type = SMILEY_HAPPY;
-			} else if (state == GAME_LOSER) {
-				smiley_type = SMILEY_SAD;
-			} else if (state == GAME_WAITING) {
-				smiley_type = SMILEY_DEFAULT;
-			} else if (state == GAME_PLAYING) {
-				if (mouse_l || mouse_r) {
-					smiley_type = SMILEY_WORRIED;
-				} else {
-					smiley_type = SMILEY_DEFAULT;
+			// Push the frame to the graphics adapter.
+			Uint64 begin = timeline.now();
+			adapter.push();
+			if (options.profile_startup && first) {
+				timeline.add("Push the first frame", begin);
+				timeline.print();
+				first = false;
+			}
+			if (options.benchmark) {
+				// Report the average frame time once enough frames have been
+				// rendered.
+				if (++frames == options.benchmark) {
+					double seconds = double(SDL_GetPerformanceCounter() - benchmark_ticks) / SDL_GetPerformanceFrequency();
+					printf("Rendered %d frames in %.2f seconds (%.3f ms per frame, %d threads)\n", frames, seconds, seconds * 1000.0 / frames, pool.size());
+					return;
 				}
+			} else {
+				// Wait for the next frame.
+				pacer.wait();
 			}
-			if (mouse_al && !mouse_l && mouse_x >= adapter.x_res / 2 - 13 && mouse_x <= adapter.x_res / 2 + 13 && mouse_y > 12 && mouse_y <= 38) {
-				smiley_type = SMILEY_PRESSED;
+		}
+		return;
+	}
+
+	// Render a frame into the video memory.
+	void render() {
+		// Everything must be drawn if the video memory lost the last frame.
+		if (adapter.lock()) {
+			invalidate();
+		}
+
+		// Render the border, which only has to be drawn once.
+		bool redraw_border = !border_drawn;
+		if (redraw_border) {
+			render_border();
+			border_drawn = true;
+		}
+
+		// Render the flag counter and the timer if their numbers changed.
+		if (flag_display.set(mines - flags) || redraw_border) {
+			adapter.draw_sprite(flag_display.sprite(), 16, 12);
+		}
+		Uint32 ticks = state == GAME_PLAYING ? SDL_GetTicks() : end_ticks;
+		if (timer_display.set((ticks - start_ticks) / 1000) || redraw_border) {
+			Sprite timer = timer_display.sprite();
+			adapter.draw_sprite(timer, adapter.x_res - 16 - timer.x_res, 12);
+		}
+
+		// Render the smiley.
+		int smiley_type;
+		if (state == GAME_WINNER) {
+			smiley_type = SMILEY_HAPPY;
+		} else if (state == GAME_LOSER) {
+			smiley_type = SMILEY_SAD;
+		} else if (state == GAME_WAITING) {
+			smiley_type = SMILEY_DEFAULT;
+		} else if (state == GAME_PLAYING) {
+			if (mouse_l || mouse_r) {
+				smiley_type = SMILEY_WORRIED;
+			} else {
+				smiley_type = SMILEY_DEFAULT;
 			}
+		}
+		if (mouse_al && !mouse_l && mouse_x >= adapter.x_res / 2 - 13 && mouse_x <= adapter.x_res / 2 + 13 && mouse_y > 12 && mouse_y <= 38) {
+			smiley_type = SMILEY_PRESSED;
+		}
+		if (smiley_type != drawn_smiley || redraw_border) {
 			adapter.draw_sprite(smiley[smiley_type], adapter.x_res / 2 - 13, 12);
+			drawn_smiley = smiley_type;
+		}
 
-			// Render the board.
-			for (int y = 0; y < y_cells; y++) {
-				for (int x = 0; x < x_cells; x++) {
-					Cell& cell = board[y * x_cells + x];
-					int tile_type;
-					if (state == GAME_WINNER && cell.is_mine) {
-						// The cell is a mine.
-						tile_type = TILE_FLAGGED;
-					} else if (state == GAME_LOSER && cell.is_mine) {
-						// The cell is a mine.
-						if (cell.is_culprit) {
-							// The cell is the culprit mine.
-							tile_type = TILE_MINE2;
-						} else if (cell.is_flagged) {
-							// The cell is a correctly flagged mine.
-							tile_type = TILE_FLAGGED;
-						} else {
-							// The cell is an undiscovered mine.
-							tile_type = TILE_MINE1;
-						}
-					} else if (state == GAME_LOSER && cell.is_flagged && !cell.is_mine) {
-						// The cell is an incorrectly flagged mine.
-						tile_type = TILE_MINE3;
-					} else if (cell.is_uncovered) {
-						// The cell is uncovered.
-						if (cell.neighbours == 0) {
-							// The cell is uncovered and has no neighbouring
-							// mines.
-							tile_type = TILE_UNCOVERED;
-						} else {
-							// The cell is uncovered and has at least one
-							// neighbouring mine.
-							tile_type = 7 + cell.neighbours;
-						}
-					} else {
-						// The cell is covered.
-						if (cell.is_flagged) {
-							// The cell is covered and is flagged.
-							tile_type = TILE_FLAGGED;
-						} else {
-							// The cell is covered and is not flagged.
-							tile_type = TILE_COVERED;
-						}
-					}
-					adapter.draw_sprite(tile[tile_type], x * 16 + xoff, y * 16 + yoff);
-				}
+		// Render the visible part of the board.
+		adapter.clip(xoff, yoff, view_x_res, view_y_res);
+		// Fill the parts of the viewport that the board does not cover.
+		int board_w = std::min(view_x_res, board_x_res() - camera_x);
+		int board_h = std::min(view_y_res, board_y_res() - camera_y);
+		adapter.fill(xoff + board_w, yoff, view_x_res - board_w, view_y_res, rgb888(128, 128, 128));
+		adapter.fill(xoff, yoff + board_h, board_w, view_y_res - board_h, rgb888(128, 128, 128));
+		if (is_lod()) {
+			// Draw one level-of-detail code per pixel.
+			render_bands(0, board_h, [&](int band_y0, int band_y1) {
+				render_lod(band_y0, band_y1);
+			});
+			invalidate_tiles();
+		} else {
+			int x0 = camera_x / cell_size;
+			int y0 = camera_y / cell_size;
+			int x1 = std::min(x_cells, (camera_x + view_x_res + cell_size - 1) / cell_size);
+			int y1 = std::min(y_cells, (camera_y + view_y_res + cell_size - 1) / cell_size);
+			// The tiles of the last frame can only be compared against if
+			// they were drawn into the video memory with the same view.
+			TileView view = {camera_x, camera_y, cell_size, y0};
+			if (options.geometry || !(view == tile_view)) {
+				drawn_tiles.assign((x1 - x0) * (y1 - y0), TILES);
 			}
-
+			tiles.resize(drawn_tiles.size());
+			tile_view = view;
 			// Render a 'pressed' cell under the mouse if the player is
 			// picking a cell.
+			pressed_x = -1;
+			pressed_y = -1;
 			if ((state == GAME_PLAYING || state == GAME_WAITING) && (mouse_l || mouse_r)) {
-				int cell_x = (mouse_x - xoff) / 16;
-				int cell_y = (mouse_y - yoff) / 16;
-				if (is_bound(cell_x, cell_y) && mouse_y > yoff && mouse_x > xoff) {
-					Cell& cell = board[cell_y * x_cells + cell_x];
-					if (!cell.is_uncovered) {
-						adapter.draw_sprite(tile[TILE_UNCOVERED], cell_x * 16 + xoff, cell_y * 16 + yoff);
-					}
+				int cell_x;
+				int cell_y;
+				if (pick(mouse_x, mouse_y, cell_x, cell_y)) {
+					pressed_x = cell_x;
+					pressed_y = cell_y;
 				}
 			}
+			// The threads can't read the chunks of a board file themselves.
+			board.fetch(x0, y0, x1, y1);
+			render_bands(y0, y1, [&](int band_y0, int band_y1) {
+				render_rows(x0, x1, band_y0, band_y1);
+			});
+			std::swap(tiles, drawn_tiles);
+		}
 
-			// Push the frame to the graphics adapter.
-			adapter.push();
-			// Cap the framerate to 60 Hz.
-			adapter.cap(60);
+		// Render the minimap inset.
+		render_minimap();
+		adapter.unclip();
+	}
+
+	// Render the border around the counters and the board.
+	void render_border() {
+		for (int y = 0; y < yoff; y += 10) {
+			for (int x = 0; x < adapter.x_res; x += 10) {
+				adapter.draw_sprite(border[BORDER_SOLID], x, y);
+			}
+		}
+		for (int x = 0; x < adapter.x_res; x += 10) {
+			adapter.draw_sprite(border[BORDER_X_SOLID], x, 0                 );
+			adapter.draw_sprite(border[BORDER_X_SOLID], x, yoff - 10         );
+			adapter.draw_sprite(border[BORDER_X_SOLID], x, adapter.y_res - 10);
+		}
+		for (int y = 0; y < adapter.y_res; y += 10) {
+			adapter.draw_sprite(border[BORDER_Y_SOLID], 0                 , y);
+			adapter.draw_sprite(border[BORDER_Y_SOLID], adapter.x_res - 10, y);
+		}
+		adapter.draw_sprite(border[BORDER_TOP_LEFT]    , 0                 , 0                 );
+		adapter.draw_sprite(border[BORDER_TOP_RIGHT]   , adapter.x_res - 10, 0                 );
+		adapter.draw_sprite(border[BORDER_BOTTOM_LEFT] , 0                 , adapter.y_res - 10);
+		adapter.draw_sprite(border[BORDER_BOTTOM_RIGHT], adapter.x_res - 10, adapter.y_res - 10);
+		adapter.draw_sprite(border[BORDER_JOINT_LEFT]  , 0                 , yoff - 10         );
+		adapter.draw_sprite(border[BORDER_JOINT_RIGHT] , adapter.x_res - 10, yoff - 10         );
+	}
+
+	// Split rows y0 to y1 (exclusive) into horizontal bands and render them
+	// in parallel. Rows never overlap, so the bands write disjoint video
+	// memory. Batched geometry is appended to a single batch, so it is always
+	// rendered on the calling thread.
+	void render_bands(int y0, int y1, std::function<void(int, int)> render) {
+		if (options.geometry || pool.size() == 1) {
+			render(y0, y1);
+		} else {
+			int bands = pool.size();
+			pool.run(bands, [&](int band) {
+				render(y0 + (y1 - y0) * band / bands, y0 + (y1 - y0) * (band + 1) / bands);
+			});
+		}
+	}
+
+	// Render the cells in columns x0 to x1 and rows y0 to y1 (exclusive).
+	// Each row is classified into the tile buffer in one pass, then only the
+	// tiles that differ from the last frame are drawn.
+	void render_rows(int x0, int x1, int y0, int y1) {
+		const Uint8* table = tile_table(state);
+		int w = x1 - x0;
+		for (int y = y0; y < y1; y++) {
+			const Cell* row = board.data() + index(x0, y);
+			Uint8* next = tiles.data() + (y - tile_view.y0) * w;
+			const Uint8* drawn = drawn_tiles.data() + (y - tile_view.y0) * w;
+			for (int i = 0; i < w; i++) {
+				next[i] = table[row[i].bits];
+			}
+			if (y == pressed_y && pressed_x >= x0 && pressed_x < x1 && !row[pressed_x - x0].is_uncovered()) {
+				next[pressed_x - x0] = TILE_UNCOVERED;
+			}
+			for (int i = 0; i < w; i++) {
+				if (next[i] != drawn[i]) {
+					draw_tile(next[i], x0 + i, y);
+				}
+			}
+		}
+	}
+
+	// Forget the tiles drawn in the last frame, so that every tile is drawn
+	// in the next frame.
+	void invalidate_tiles() {
+		tile_view.cell_size = 0;
+	}
+
+	// Forget everything drawn in the last frame.
+	void invalidate() {
+		invalidate_tiles();
+		border_drawn = false;
+	}
+
+	// Render rows y0 to y1 (exclusive) of the viewport with one
+	// level-of-detail code per pixel.
+	void render_lod(int y0, int y1) {
+		int w = std::min(view_x_res, board_x_res() - camera_x);
+		for (int y = y0; y < y1; y++) {
+			if (block_shift > 0) {
+				// Each pixel is a block of cells.
+				const Uint8* row = minimap.row(block_shift, camera_y + y) + camera_x;
+				for (int x = 0; x < w; x++) {
+					adapter.set(xoff + x, yoff + y, lod_pens[row[x]]);
+				}
+			} else {
+				// Each cell is one or more pixels.
+				const Uint8* row = minimap.row(0, (camera_y + y) / cell_size);
+				for (int x = 0; x < w; x++) {
+					adapter.set(xoff + x, yoff + y, lod_pens[row[(camera_x + x) / cell_size]]);
+				}
+			}
+		}
+	}
+
+	// Render the minimap inset, with the viewport outlined.
+	void render_minimap() {
+		SDL_Rect inset;
+		int level;
+		if (!minimap_rect(inset, level)) {
+			return;
+		}
+		adapter.fill(inset.x - 1, inset.y - 1, inset.w + 2, inset.h + 2, rgb888(0, 0, 0));
+		for (int y = 0; y < inset.h; y++) {
+			const Uint8* row = minimap.row(level, y);
+			for (int x = 0; x < inset.w; x++) {
+				adapter.set(inset.x + x, inset.y + y, lod_pens[row[x]]);
+			}
+		}
+		// Outline the part of the board that is in the viewport.
+		int x0 = int(camera_x / pixels_per_cell()) >> level;
+		int y0 = int(camera_y / pixels_per_cell()) >> level;
+		int x1 = std::min(inset.w, (int((camera_x + view_x_res) / pixels_per_cell()) >> level) + 1);
+		int y1 = std::min(inset.h, (int((camera_y + view_y_res) / pixels_per_cell()) >> level) + 1);
+		Uint32 outline = rgb888(0, 0, 255);
+		adapter.fill(inset.x + x0    , inset.y + y0    , x1 - x0, 1      , outline);
+		adapter.fill(inset.x + x0    , inset.y + y1 - 1, x1 - x0, 1      , outline);
+		adapter.fill(inset.x + x0    , inset.y + y0    , 1      , y1 - y0, outline);
+		adapter.fill(inset.x + x1 - 1, inset.y + y0    , 1      , y1 - y0, outline);
+		// Keep the minimap on top of batched geometry.
+		SDL_Rect border = {inset.x - 1, inset.y - 1, inset.w + 2, inset.h + 2};
+		adapter.overlay(border);
+	}
+
+	// Find the tile that a cell is drawn with.
+	inline int classify(const Cell& cell) {
+		return tile_table(state)[cell.bits];
+	}
+
+	// The tiles of every combination of cell bits in a game state. The table
+	// is built once, on first use.
+	static const Uint8* tile_table(int state) {
+		static const std::array<Uint8, GAME_STATES * 256> table = [] {
+			std::array<Uint8, GAME_STATES * 256> table;
+			for (int state = 0; state < GAME_STATES; state++) {
+				for (int bits = 0; bits < 256; bits++) {
+					Cell cell;
+					cell.bits = bits;
+					table[state * 256 + bits] = classify(state, cell);
+				}
+			}
+			return table;
+		}();
+		return table.data() + state * 256;
+	}
+
+	// Find the tile that a cell is drawn with in a game state, without the
+	// table.
+	static int classify(int state, const Cell& cell) {
+		int tile_type;
+		if (state == GAME_WINNER && cell.is_mine()) {
+			// The cell is a mine.
+			tile_type = TILE_FLAGGED;
+		} else if (state == GAME_LOSER && cell.is_mine()) {
+			// The cell is a mine.
+			if (cell.is_culprit()) {
+				// The cell is the culprit mine.
+				tile_type = TILE_MINE2;
+			} else if (cell.is_flagged()) {
+				// The cell is a correctly flagged mine.
+				tile_type = TILE_FLAGGED;
+			} else {
+				// The cell is an undiscovered mine.
+				tile_type = TILE_MINE1;
+			}
+		} else if (state == GAME_LOSER && cell.is_flagged() && !cell.is_mine()) {
+			// The cell is an incorrectly flagged mine.
+			tile_type = TILE_MINE3;
+		} else if (cell.is_uncovered()) {
+			// The cell is uncovered.
+			if (cell.neighbours() == 0) {
+				// The cell is uncovered and has no neighbouring
+				// mines.
+				tile_type = TILE_UNCOVERED;
+			} else {
+				// The cell is uncovered and has at least one
+				// neighbouring mine.
+				tile_type = 7 + cell.neighbours();
+			}
+		} else {
+			// The cell is covered.
+			if (cell.is_flagged()) {
+				// The cell is covered and is flagged.
+				tile_type = TILE_FLAGGED;
+			} else {
+				// The cell is covered and is not flagged.
+				tile_type = TILE_COVERED;
+			}
+		}
+		return tile_type;
+	}
+
+	// Draw a tile over a cell of the game board, either into the video memory
+	// or as batched geometry.
+	inline void draw_tile(int tile_type, int cell_x, int cell_y) {
+		int x = xoff + cell_x * cell_size - camera_x;
+		int y = yoff + cell_y * cell_size - camera_y;
+		if (options.geometry) {
+			SDL_Rect src = {0, tile_type * 16, 16, 16};
+			SDL_Rect dst = {x, y, cell_size, cell_size};
+			adapter.draw_atlas(tile_atlas, src, dst);
+		} else {
+			adapter.draw_sprite_scaled(tile[tile_type], x, y, cell_size, cell_size);
 		}
-		return;
 	}
 
 	// End the game.
 	void end() {
+		if (options.frame_stats) {
+			pacer.print_stats();
+		}
+		flush_board();
 		adapter.quit();
 	}
 };
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include <vector>
+#include <algorithm>
+
+// Level-of-detail codes. A block of cells shows the highest code of any of
+// its cells, so covered and revealed mines stand out when zoomed far out.
+enum {
+	LOD_EMPTY,
+	LOD_NUMBER,
+	LOD_COVERED,
+	LOD_FLAGGED,
+	LOD_MINE,
+	LOD_WRONG_FLAG,
+	LOD_CULPRIT,
+	LOD_CODES
+};
+
+// A pyramid of level-of-detail codes. Level 0 holds one code per cell, and
+// every following level holds one code per 2x2 block of the level below.
+class Minimap {
+private:
+	// The codes of each level, and the dimensions of each level.
+	std::vector<std::vector<Uint8>> levels;
+	std::vector<int> x_res;
+	std::vector<int> y_res;
+
+	// Recompute the code of a block from the level below it.
+	inline Uint8 combine(int level, int x, int y) {
+		const std::vector<Uint8>& below = levels[level - 1];
+		int w = x_res[level - 1];
+		int h = y_res[level - 1];
+		int i = x * 2;
+		int j = y * 2;
+		Uint8 code = below[j * w + i];
+		if (i + 1 < w) {
+			code = std::max(code, below[j * w + i + 1]);
+		}
+		if (j + 1 < h) {
+			code = std::max(code, below[(j + 1) * w + i]);
+			if (i + 1 < w) {
+				code = std::max(code, below[(j + 1) * w + i + 1]);
+			}
+		}
+		return code;
+	}
+
+public:
+	// Null constructor.
+	Minimap() {}
+
+	// Default constructor. Levels are added until a level is a single code.
+	Minimap(int x_cells, int y_cells) {
+		int w = x_cells;
+		int h = y_cells;
+		while (1) {
+			levels.push_back(std::vector<Uint8>((size_t)w * h, LOD_COVERED));
+			x_res.push_back(w);
+			y_res.push_back(h);
+			if (w == 1 && h == 1) {
+				break;
+			}
+			w = (w + 1) / 2;
+			h = (h + 1) / 2;
+		}
+	}
+
+	// The number of levels.
+	int size() {
+		return levels.size();
+	}
+
+	// The dimensions of a level.
+	int width(int level) {
+		return x_res[level];
+	}
+	int height(int level) {
+		return y_res[level];
+	}
+
+	// Get the code of a block of a level.
+	inline Uint8 get(int level, int x, int y) {
+		return levels[level][(size_t)y * x_res[level] + x];
+	}
+
+	// A row of codes of a level.
+	inline const Uint8* row(int level, int y) {
+		return levels[level].data() + (size_t)y * x_res[level];
+	}
+
+	// Set the code of a cell and update the levels above it. Updating stops
+	// as soon as a block's code does not change.
+	void set(int x, int y, Uint8 code) {
+		Uint8& cell = levels[0][(size_t)y * x_res[0] + x];
+		if (cell == code) {
+			return;
+		}
+		cell = code;
+		for (int level = 1; level < size(); level++) {
+			x /= 2;
+			y /= 2;
+			Uint8 block = combine(level, x, y);
+			Uint8& old = levels[level][(size_t)y * x_res[level] + x];
+			if (old == block) {
+				return;
+			}
+			old = block;
+		}
+	}
+
+	// Set the code of a cell without updating the levels above it. Call
+	// build() after a batch of these.
+	inline void set_base(int x, int y, Uint8 code) {
+		levels[0][(size_t)y * x_res[0] + x] = code;
+	}
+
+	// Recompute every level above level 0.
+	void build() {
+		for (int level = 1; level < size(); level++) {
+			for (int y = 0; y < y_res[level]; y++) {
+				for (int x = 0; x < x_res[level]; x++) {
+					levels[level][(size_t)y * x_res[level] + x] = combine(level, x, y);
+				}
+			}
+		}
+	}
+};
\ No newline at end of file
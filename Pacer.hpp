@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <math.h>
+
+#include <algorithm>
+
+// Paces frames to a target rate with the high-resolution performance
+// counter. Each frame sleeps until shortly before its deadline and then
+// spins for the rest, so oversleeping doesn't cause jitter. The margin left
+// for spinning adapts to how much the operating system oversleeps.
+class Pacer {
+private:
+	// Performance counter ticks per second, per frame (zero for no target)
+	// and before spinning.
+	Uint64 frequency = 0;
+	Uint64 period = 0;
+	Uint64 margin = 0;
+
+	// The deadline of the next frame.
+	Uint64 deadline = 0;
+
+	// Statistics of the intervals between frames, in milliseconds.
+	Uint64 previous = 0;
+	int intervals = 0;
+	double sum = 0.0;
+	double sum_squares = 0.0;
+	double shortest = 0.0;
+	double longest = 0.0;
+	int missed = 0;
+
+	// Sleep most of the way to a time, then spin until it.
+	void sleep_until(Uint64 time) {
+		Uint64 now = SDL_GetPerformanceCounter();
+		if (time > now + margin) {
+			Uint32 ms = (time - now - margin) * 1000 / frequency;
+			if (ms > 0) {
+				SDL_Delay(ms);
+				// Leave at least as much time as the sleep overran by, and
+				// let the margin shrink back slowly.
+				Uint64 slept = SDL_GetPerformanceCounter() - now;
+				Uint64 asked = ms * frequency / 1000;
+				Uint64 overran = slept > asked ? slept - asked : 0;
+				margin = std::max(overran, margin - margin / 64);
+			}
+		}
+		while (SDL_GetPerformanceCounter() < time) {
+			// Spin.
+		}
+	}
+
+	// Add the interval since the last frame to the statistics.
+	void record(Uint64 now) {
+		if (previous) {
+			double ms = double(now - previous) * 1000.0 / frequency;
+			if (intervals == 0) {
+				shortest = ms;
+				longest = ms;
+			}
+			shortest = std::min(shortest, ms);
+			longest = std::max(longest, ms);
+			sum += ms;
+			sum_squares += ms * ms;
+			intervals++;
+			if (period && now - previous > period * 3 / 2) {
+				missed++;
+			}
+		}
+		previous = now;
+	}
+
+public:
+	// Default constructor. A target of zero frames per second doesn't wait.
+	Pacer(int fps = 60) {
+		frequency = SDL_GetPerformanceFrequency();
+		period = fps > 0 ? frequency / fps : 0;
+		margin = frequency / 1000;
+	}
+
+	// Wait until the next frame is due.
+	void wait() {
+		if (period) {
+			Uint64 now = SDL_GetPerformanceCounter();
+			if (!deadline || now > deadline + period) {
+				// Start over rather than rush to catch up on missed frames.
+				deadline = now + period;
+			}
+			sleep_until(deadline);
+			deadline += period;
+		}
+		record(SDL_GetPerformanceCounter());
+	}
+
+	// Print the statistics of the intervals between frames.
+	void print_stats() {
+		if (intervals == 0) {
+			return;
+		}
+		double mean = sum / intervals;
+		double jitter = sqrt(std::max(0.0, sum_squares / intervals - mean * mean));
+		printf("Paced %d frames: %.3f ms mean, %.3f ms jitter (standard deviation), %.3f ms shortest, %.3f ms longest, %d missed\n", intervals + 1, mean, jitter, shortest, longest, missed);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include <algorithm>
+
+// SSSE3 lookups are compiled in on x86 with GCC and Clang, and used when the
+// processor supports them.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PALETTE_SSSE3
+#include <tmmintrin.h>
+#endif
+
+// A palette of up to 256 ARGB8888 colors, for indexed video memory and
+// sprites.
+class Palette {
+private:
+	// The colors.
+	Uint32 colors[256];
+	int count = 0;
+
+	// The bytes of the first 16 colors, one table per byte of ARGB8888 in
+	// memory order, so that 16 indices can be expanded with 4 byte shuffles.
+	alignas(16) Uint8 tables[4][16] = {};
+
+#ifdef PALETTE_SSSE3
+	// Expand as many whole groups of 16 indices as possible. Only valid while
+	// the palette has at most 16 colors. Returns the number of indices
+	// expanded.
+	__attribute__((target("ssse3")))
+	int expand_ssse3(const Uint8* indices, Uint32* pixels, int n) const {
+		__m128i b = _mm_load_si128((const __m128i*)tables[0]);
+		__m128i g = _mm_load_si128((const __m128i*)tables[1]);
+		__m128i r = _mm_load_si128((const __m128i*)tables[2]);
+		__m128i a = _mm_load_si128((const __m128i*)tables[3]);
+		int i = 0;
+		for (; i + 16 <= n; i += 16) {
+			__m128i index = _mm_loadu_si128((const __m128i*)(indices + i));
+			// Look up each byte of the 16 colors.
+			__m128i pb = _mm_shuffle_epi8(b, index);
+			__m128i pg = _mm_shuffle_epi8(g, index);
+			__m128i pr = _mm_shuffle_epi8(r, index);
+			__m128i pa = _mm_shuffle_epi8(a, index);
+			// Interleave the bytes back into pixels.
+			__m128i bg0 = _mm_unpacklo_epi8(pb, pg);
+			__m128i bg1 = _mm_unpackhi_epi8(pb, pg);
+			__m128i ra0 = _mm_unpacklo_epi8(pr, pa);
+			__m128i ra1 = _mm_unpackhi_epi8(pr, pa);
+			_mm_storeu_si128((__m128i*)(pixels + i +  0), _mm_unpacklo_epi16(bg0, ra0));
+			_mm_storeu_si128((__m128i*)(pixels + i +  4), _mm_unpackhi_epi16(bg0, ra0));
+			_mm_storeu_si128((__m128i*)(pixels + i +  8), _mm_unpacklo_epi16(bg1, ra1));
+			_mm_storeu_si128((__m128i*)(pixels + i + 12), _mm_unpackhi_epi16(bg1, ra1));
+		}
+		return i;
+	}
+#endif
+
+public:
+	// The number of colors.
+	int size() const {
+		return count;
+	}
+
+	// The color of an index.
+	inline Uint32 color(Uint8 index) const {
+		return colors[index];
+	}
+
+	// Find the index of a color, adding the color if it is new. Returns -1 if
+	// the color is new and the palette is full.
+	int index(Uint32 color) {
+		Uint32* found = std::find(colors, colors + count, color);
+		if (found != colors + count) {
+			return found - colors;
+		}
+		if (count == 256) {
+			return -1;
+		}
+		if (count < 16) {
+			for (int k = 0; k < 4; k++) {
+				tables[k][count] = color >> (k * 8);
+			}
+		}
+		colors[count] = color;
+		return count++;
+	}
+
+	// Expand n indices to ARGB8888 pixels.
+	void expand(const Uint8* indices, Uint32* pixels, int n) const {
+		int i = 0;
+#ifdef PALETTE_SSSE3
+		static const bool ssse3 = SDL_HasSSSE3();
+		if (ssse3 && count <= 16) {
+			i = expand_ssse3(indices, pixels, n);
+		}
+#endif
+		for (; i < n; i++) {
+			pixels[i] = colors[indices[i]];
+		}
+	}
+};
\ No newline at end of file
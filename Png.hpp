@@ -0,0 +1,275 @@
+#include <stdio.h>
+
+#include <array>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+// A minimal PNG encoder. Images with at most 256 colors are written as
+// palette images, and the image data is compressed with fixed-Huffman
+// deflate.
+class Png {
+private:
+	// A little-endian bit stream, as used by deflate.
+	struct Bits {
+		std::vector<Uint8>& out;
+		Uint32 buffer = 0;
+		int count = 0;
+
+		Bits(std::vector<Uint8>& out): out(out) {}
+
+		// Write the low n bits of value, least significant bit first.
+		inline void put(Uint32 value, int n) {
+			buffer |= value << count;
+			count += n;
+			while (count >= 8) {
+				out.push_back(buffer & 0xFF);
+				buffer >>= 8;
+				count -= 8;
+			}
+		}
+
+		// Write a Huffman code of n bits, most significant bit first.
+		inline void put_code(Uint32 code, int n) {
+			Uint32 reversed = 0;
+			for (int i = 0; i < n; i++) {
+				reversed = (reversed << 1) | ((code >> i) & 1);
+			}
+			put(reversed, n);
+		}
+
+		// Write the remaining bits, padded to a whole byte.
+		void flush() {
+			if (count > 0) {
+				out.push_back(buffer & 0xFF);
+			}
+			buffer = 0;
+			count = 0;
+		}
+	};
+
+	// Write a literal or length symbol with the fixed Huffman code.
+	static inline void put_symbol(Bits& bits, int symbol) {
+		if (symbol < 144) {
+			bits.put_code(0x30 + symbol, 8);
+		} else if (symbol < 256) {
+			bits.put_code(0x190 + symbol - 144, 9);
+		} else if (symbol < 280) {
+			bits.put_code(symbol - 256, 7);
+		} else {
+			bits.put_code(0xC0 + symbol - 280, 8);
+		}
+	}
+
+	// Write a match of a length and distance.
+	static inline void put_match(Bits& bits, int length, int distance) {
+		static const int length_base[29] = {
+			3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+			35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+		};
+		static const int length_extra[29] = {
+			0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+			3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+		};
+		static const int distance_base[30] = {
+			1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+			257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+			8193, 12289, 16385, 24577
+		};
+		static const int distance_extra[30] = {
+			0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+			7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+		};
+		int l = 28;
+		while (length_base[l] > length) {
+			l--;
+		}
+		put_symbol(bits, 257 + l);
+		bits.put(length - length_base[l], length_extra[l]);
+		int d = 29;
+		while (distance_base[d] > distance) {
+			d--;
+		}
+		bits.put_code(d, 5);
+		bits.put(distance - distance_base[d], distance_extra[d]);
+	}
+
+	// Compress data into a zlib stream.
+	static std::vector<Uint8> deflate(const std::vector<Uint8>& data) {
+		std::vector<Uint8> out;
+		out.reserve(data.size() / 4 + 64);
+		// The zlib header (32K window, no dictionary).
+		out.push_back(0x78);
+		out.push_back(0x01);
+
+		Bits bits(out);
+		// A single final block with fixed Huffman codes.
+		bits.put(1, 1);
+		bits.put(1, 2);
+
+		// Find matches with a hash table of the most recent position of
+		// each 3-byte sequence.
+		const int window = 32768;
+		const int hash_bits = 15;
+		std::vector<int> head(1 << hash_bits, -1);
+		int n = data.size();
+		int i = 0;
+		while (i < n) {
+			int length = 0;
+			int distance = 0;
+			if (i + 3 <= n) {
+				Uint32 hash = (data[i] << 16 | data[i + 1] << 8 | data[i + 2]) * 2654435761u >> (32 - hash_bits);
+				int candidate = head[hash];
+				head[hash] = i;
+				if (candidate >= 0 && i - candidate <= window) {
+					int limit = std::min(258, n - i);
+					while (length < limit && data[candidate + length] == data[i + length]) {
+						length++;
+					}
+					distance = i - candidate;
+				}
+			}
+			if (length >= 3) {
+				put_match(bits, length, distance);
+				i += length;
+			} else {
+				put_symbol(bits, data[i]);
+				i++;
+			}
+		}
+		put_symbol(bits, 256);
+		bits.flush();
+
+		// The Adler-32 checksum of the uncompressed data.
+		Uint32 a = 1;
+		Uint32 b = 0;
+		for (int j = 0; j < n; j++) {
+			a = (a + data[j]) % 65521;
+			b = (b + a) % 65521;
+		}
+		Uint32 adler = b << 16 | a;
+		put_u32(out, adler);
+		return out;
+	}
+
+	// Append a big-endian 32-bit integer.
+	static inline void put_u32(std::vector<Uint8>& out, Uint32 value) {
+		out.push_back(value >> 24);
+		out.push_back(value >> 16);
+		out.push_back(value >> 8);
+		out.push_back(value);
+	}
+
+	// Find the CRC-32 of a buffer.
+	static Uint32 crc32(const Uint8* data, size_t size) {
+		// The table is built once, on first use.
+		static const std::array<Uint32, 256> table = [] {
+			std::array<Uint32, 256> table;
+			for (Uint32 i = 0; i < 256; i++) {
+				Uint32 c = i;
+				for (int k = 0; k < 8; k++) {
+					c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+				}
+				table[i] = c;
+			}
+			return table;
+		}();
+		Uint32 crc = ~0u;
+		for (size_t i = 0; i < size; i++) {
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	// Write a chunk.
+	static void put_chunk(FILE* file, const char* type, const std::vector<Uint8>& data) {
+		std::vector<Uint8> chunk;
+		put_u32(chunk, data.size());
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		put_u32(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+		fwrite(chunk.data(), 1, chunk.size(), file);
+	}
+
+public:
+	// Write ARGB8888 pixels to a PNG file. The pitch is the number of pixels
+	// per row of the source. Returns false if the file could not be written.
+	static bool write(std::string filename, const Uint32* pixels, int x_res, int y_res, int pitch) {
+		// Lay out the image data, one filter byte (none) per row. Palette
+		// indices are used until the image turns out to have more than 256
+		// colors.
+		std::vector<Uint32> palette;
+		std::vector<Uint8> raw;
+		raw.reserve((size_t)(x_res + 1) * y_res);
+		bool indexed = true;
+		for (int y = 0; y < y_res && indexed; y++) {
+			raw.push_back(0);
+			// Consecutive pixels are usually the same color, so remember the
+			// last palette lookup.
+			Uint32 last = ~0u;
+			Uint8 index = 0;
+			for (int x = 0; x < x_res; x++) {
+				Uint32 pixel = pixels[y * pitch + x] & 0xFFFFFF;
+				if (pixel != last) {
+					size_t i = std::find(palette.begin(), palette.end(), pixel) - palette.begin();
+					if (i == palette.size()) {
+						if (i == 256) {
+							indexed = false;
+							break;
+						}
+						palette.push_back(pixel);
+					}
+					index = i;
+					last = pixel;
+				}
+				raw.push_back(index);
+			}
+		}
+		if (!indexed) {
+			raw.clear();
+			raw.reserve((size_t)(x_res * 3 + 1) * y_res);
+			for (int y = 0; y < y_res; y++) {
+				raw.push_back(0);
+				for (int x = 0; x < x_res; x++) {
+					Uint32 pixel = pixels[y * pitch + x];
+					raw.push_back(pixel >> 16);
+					raw.push_back(pixel >> 8);
+					raw.push_back(pixel);
+				}
+			}
+		}
+
+		FILE* file = fopen(filename.c_str(), "wb");
+		if (!file) {
+			return false;
+		}
+		static const Uint8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+		fwrite(signature, 1, 8, file);
+
+		std::vector<Uint8> header;
+		put_u32(header, x_res);
+		put_u32(header, y_res);
+		header.push_back(8);
+		header.push_back(indexed ? 3 : 2);
+		header.push_back(0);
+		header.push_back(0);
+		header.push_back(0);
+		put_chunk(file, "IHDR", header);
+
+		if (indexed) {
+			std::vector<Uint8> colors;
+			for (Uint32 color: palette) {
+				colors.push_back(color >> 16);
+				colors.push_back(color >> 8);
+				colors.push_back(color);
+			}
+			put_chunk(file, "PLTE", colors);
+		}
+
+		put_chunk(file, "IDAT", deflate(raw));
+		put_chunk(file, "IEND", std::vector<Uint8>());
+		bool ok = !ferror(file);
+		fclose(file);
+		return ok;
+	}
+};
\ No newline at end of file
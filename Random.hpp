@@ -0,0 +1,34 @@
+// A small, fast pseudorandom number generator (xorshift64*). Its whole state
+// is one number, so a game can be saved and replayed exactly.
+class Random {
+public:
+	Uint64 state;
+
+	// Default constructor.
+	Random(Uint64 seed = 0) {
+		// Scramble the seed, as nearby seeds would otherwise start out alike,
+		// and keep the state from being zero.
+		state = hash(seed) | 1;
+	}
+
+	// The next number.
+	inline Uint64 next() {
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return state * 2685821657736338717ull;
+	}
+
+	// A number from 0 to n - 1.
+	inline Uint32 below(Uint32 n) {
+		return ((next() >> 32) * n) >> 32;
+	}
+
+	// Mix the bits of a number (the splitmix64 finalizer).
+	static Uint64 hash(Uint64 x) {
+		x += 0x9E3779B97F4A7C15ull;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		return x ^ (x >> 31);
+	}
+};
\ No newline at end of file
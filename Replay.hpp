@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+
+// Replay records. A replay file starts with the magic "MSWPRPLY" and a
+// version, followed by records. Each record is a varint of milliseconds
+// since the previous record and a varint of its kind in the low 3 bits and
+// its value above them, followed by any arguments:
+//
+//   REPLAY_GAME     a new game: varints of the width, height and mines, and
+//                   the 64-bit little-endian seed of the game board
+//   REPLAY_UNCOVER  uncover a cell
+//   REPLAY_FLAG     flag or unflag a cell
+//   REPLAY_SOLVE    solve the board
+//   REPLAY_WIN      the game was won after the value in milliseconds
+//   REPLAY_LOSS     the game was lost after the value in milliseconds
+//
+// The value of a cell is the zigzag-encoded difference between its index
+// and the index of the cell of the previous action of the game, as players
+// tend to act near where they last acted. Most actions take two to four
+// bytes, so an expert game, flags and all, takes about a kilobyte.
+enum {
+	REPLAY_GAME,
+	REPLAY_UNCOVER,
+	REPLAY_FLAG,
+	REPLAY_SOLVE,
+	REPLAY_WIN,
+	REPLAY_LOSS,
+	REPLAY_KINDS
+};
+
+// Streams replay records to a file. Records are gathered in memory by the
+// game and handed to a writer thread at most once a frame, without ever
+// waiting for the writer: if the writer is busy or behind, the records stay
+// in memory until the next hand-over, or until they pass MAX_PENDING bytes,
+// when the game waits for the writer rather than grow without bound.
+class ReplayWriter {
+public:
+	static const Uint32 VERSION = 1;
+
+private:
+	// The most chunks of records waiting for the writer.
+	static const size_t MAX_CHUNKS = 16;
+	// The most bytes of records kept while the writer is behind.
+	static const size_t MAX_PENDING = 1 << 20;
+
+	std::string filename;
+	FILE* file = NULL;
+	bool failed = false;
+
+	// Records not yet handed to the writer, the time of the last record and
+	// the cell of the last action.
+	std::vector<Uint8> pending;
+	Uint32 last_ticks = 0;
+	bool started = false;
+	Sint64 last_cell = 0;
+
+	BackgroundWriter<std::vector<Uint8>> writer;
+
+	// Write a round of chunks.
+	void write(std::deque<std::vector<Uint8>>& chunks) {
+		bool ok = true;
+		for (std::vector<Uint8>& chunk: chunks) {
+			ok = fwrite(chunk.data(), 1, chunk.size(), file) == chunk.size() && ok;
+		}
+		ok = fflush(file) == 0 && ok;
+		// Report the first failure.
+		if (!ok && !failed) {
+			fprintf(stderr, "Could not write \"%s\", so the replay is incomplete.\n", filename.c_str());
+			failed = true;
+		}
+	}
+
+	// Start a record.
+	void put_record(int kind, Uint64 value, Uint32 ticks) {
+		put_varint(pending, started ? ticks - last_ticks : 0);
+		put_varint(pending, kind | value << 3);
+		last_ticks = ticks;
+		started = true;
+	}
+
+public:
+	// Default constructor. Check is_open() to see if the file was created.
+	ReplayWriter(std::string filename):
+		filename(filename),
+		writer(MAX_CHUNKS, [this](std::deque<std::vector<Uint8>>& chunks) { write(chunks); })
+	{
+		file = fopen(filename.c_str(), "wb");
+		if (!file) {
+			return;
+		}
+		const char* magic = "MSWPRPLY";
+		pending.insert(pending.end(), magic, magic + 8);
+		put_le(pending, VERSION, 4);
+	}
+
+	// Destructor. Waits for every record to be written.
+	~ReplayWriter() {
+		if (!file) {
+			return;
+		}
+		if (!pending.empty()) {
+			writer.stop(pending);
+		}
+		writer.stop();
+		fclose(file);
+	}
+
+	ReplayWriter(const ReplayWriter&) = delete;
+	ReplayWriter& operator=(const ReplayWriter&) = delete;
+
+	// Check if the file was created.
+	bool is_open() {
+		return file != NULL;
+	}
+
+	// Record the start of a game.
+	void game(int x_cells, int y_cells, int mines, Uint64 seed, Uint32 ticks) {
+		put_record(REPLAY_GAME, 0, ticks);
+		last_cell = 0;
+		put_varint(pending, x_cells);
+		put_varint(pending, y_cells);
+		put_varint(pending, mines);
+		put_le(pending, seed, 8);
+	}
+
+	// Record an action on a cell.
+	void action(int kind, Sint64 cell, Uint32 ticks) {
+		put_record(kind, zigzag(cell - last_cell), ticks);
+		last_cell = cell;
+	}
+
+	// Record the result of a game.
+	void result(bool won, Uint32 elapsed, Uint32 ticks) {
+		put_record(won ? REPLAY_WIN : REPLAY_LOSS, elapsed, ticks);
+	}
+
+	// Hand the records so far to the writer thread, unless it is busy and
+	// they still fit in MAX_PENDING.
+	void flush() {
+		if (pending.empty() || !file) {
+			return;
+		}
+		if (writer.offer(pending)) {
+			pending.clear();
+		} else if (pending.size() >= MAX_PENDING) {
+			writer.push(pending);
+			pending.clear();
+		}
+	}
+};
+
+// A replay record. Only the fields of its kind are set.
+struct ReplayRecord {
+	int kind = REPLAY_GAME;
+	Uint32 ticks = 0;
+	// A game's settings and seed.
+	int x_cells = 0;
+	int y_cells = 0;
+	int mines = 0;
+	Uint64 seed = 0;
+	// An action's cell.
+	Sint64 cell = 0;
+	// A result's elapsed milliseconds.
+	Uint32 elapsed = 0;
+};
+
+// Reads replay records from a buffer.
+class ReplayReader {
+private:
+	const Uint8* start;
+	Reader in;
+	Uint32 ticks = 0;
+	Sint64 last_cell = 0;
+	Sint64 cells = 0;
+	bool valid = true;
+
+public:
+	// Default constructor. The buffer holds records, without the header.
+	ReplayReader(const Uint8* data, size_t size): start(data), in(data, size) {}
+
+	// Check the header of a replay file and return where its records start,
+	// or zero if it isn't a replay file of this version.
+	static size_t skip_header(const std::vector<Uint8>& data) {
+		Reader in(data.data(), data.size());
+		const Uint8* magic = in.skip(8);
+		if (!magic || memcmp(magic, "MSWPRPLY", 8) != 0 || in.le(4) != ReplayWriter::VERSION) {
+			return 0;
+		}
+		return 12;
+	}
+
+	// The number of bytes read so far.
+	size_t offset() {
+		return in.data - start;
+	}
+
+	// Read the next record. Returns false at the end of the buffer or at an
+	// invalid record, which is_valid() tells apart.
+	bool next(ReplayRecord& record) {
+		if (in.data == in.end || !valid) {
+			return false;
+		}
+		ticks += in.varint();
+		Uint64 head = in.varint();
+		record = ReplayRecord();
+		record.kind = head & 7;
+		record.ticks = ticks;
+		Uint64 value = head >> 3;
+		if (record.kind == REPLAY_GAME) {
+			record.x_cells = in.varint();
+			record.y_cells = in.varint();
+			record.mines = in.varint();
+			record.seed = in.le(8);
+			valid = record.x_cells > 0 && record.y_cells > 0 && record.mines >= 0 &&
+					record.x_cells <= Board::MAX_SIDE && record.y_cells <= Board::MAX_SIDE &&
+					record.mines + 9 <= Sint64(record.x_cells) * record.y_cells;
+			cells = Sint64(record.x_cells) * record.y_cells;
+			last_cell = 0;
+		} else if (record.kind == REPLAY_UNCOVER || record.kind == REPLAY_FLAG || record.kind == REPLAY_SOLVE) {
+			Sint64 cell = last_cell + unzigzag(value);
+			valid = cells > 0 && cell >= 0 && cell < cells;
+			record.cell = last_cell = cell;
+		} else if (record.kind == REPLAY_WIN || record.kind == REPLAY_LOSS) {
+			valid = cells > 0 && value <= 0xFFFFFFFF;
+			record.elapsed = value;
+		} else {
+			valid = false;
+		}
+		valid = valid && in.ok;
+		return valid;
+	}
+
+	// Check if every record read so far was valid.
+	bool is_valid() {
+		return valid;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+// A saved game. The file starts with the magic "MSWPSAVE" and a version,
+// followed by the settings, the random state, the game state and the
+// elapsed milliseconds, all little-endian. The board follows as three bit
+// planes of mines, uncovered cells and flagged cells, one bit per cell in
+// row-major order, each stored as raw bits or as runs (see put_plane()).
+// Everything else about the board, such as the neighbouring mine counts, is
+// recalculated when the game is loaded.
+struct SaveGame {
+	static const Uint32 VERSION = 1;
+	// The largest width and height accepted, to reject corrupt files before
+	// allocating their planes.
+	static const int MAX_SIDE = 32768;
+
+	// The settings.
+	int x_cells = 0;
+	int y_cells = 0;
+	int mines = 0;
+
+	// The seed of the game board and the state of its random number
+	// generator.
+	Uint64 seed = 0;
+	Uint64 random = 0;
+
+	// The game state, the elapsed milliseconds and the cell of the mine that
+	// lost the game, or -1.
+	int state = 0;
+	Uint32 elapsed = 0;
+	Sint64 culprit = -1;
+
+	// The bit planes.
+	BitPlane mine;
+	BitPlane uncovered;
+	BitPlane flagged;
+
+	// Append the game in the format of a file.
+	void put(std::vector<Uint8>& out) const {
+		const char* magic = "MSWPSAVE";
+		out.insert(out.end(), magic, magic + 8);
+		put_le(out, VERSION, 4);
+		put_le(out, x_cells, 4);
+		put_le(out, y_cells, 4);
+		put_le(out, mines, 4);
+		put_le(out, seed, 8);
+		put_le(out, random, 8);
+		put_le(out, state, 1);
+		put_le(out, elapsed, 4);
+		put_le(out, culprit + 1, 8);
+		size_t cells = size_t(x_cells) * y_cells;
+		put_plane(out, mine, cells);
+		put_plane(out, uncovered, cells);
+		put_plane(out, flagged, cells);
+	}
+
+	// Write the game to a file. Returns false if it can't be written.
+	bool write(std::string filename) const {
+		std::vector<Uint8> out;
+		put(out);
+		return write_file(filename, out);
+	}
+
+	// Read a game in the format of a file from a reader, which is left after
+	// it. Returns false if it isn't a valid saved game of this version.
+	bool get(Reader& in) {
+		const Uint8* magic = in.skip(8);
+		if (!magic || memcmp(magic, "MSWPSAVE", 8) != 0 || in.le(4) != VERSION) {
+			return false;
+		}
+		x_cells = in.le(4);
+		y_cells = in.le(4);
+		mines = in.le(4);
+		seed = in.le(8);
+		random = in.le(8);
+		state = in.le(1);
+		elapsed = in.le(4);
+		culprit = Sint64(in.le(8)) - 1;
+		size_t cells = size_t(x_cells) * y_cells;
+		if (!in.ok || x_cells <= 0 || y_cells <= 0 || x_cells > MAX_SIDE || y_cells > MAX_SIDE || mines < 0 || size_t(mines) > cells || culprit >= Sint64(cells)) {
+			return false;
+		}
+		return get_plane(in, mine, cells) &&
+			   get_plane(in, uncovered, cells) &&
+			   get_plane(in, flagged, cells);
+	}
+
+	// Read a game from a file. Returns false if it can't be read or isn't a
+	// valid saved game of this version.
+	bool read(std::string filename) {
+		std::vector<Uint8> data;
+		if (!read_file(filename, data)) {
+			return false;
+		}
+		Reader in(data.data(), data.size());
+		return get(in) && in.done();
+	}
+};
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+// Writes screenshots as PNG files on a writer thread. A capture copies the
+// video memory into a spare buffer and hands it to the writer without ever
+// waiting for it, so the frame loop never waits on encoding or the disk.
+// The writer keeps a spare buffer ready, as allocating one takes longer
+// than the copy itself, so only captures faster than the writer allocate.
+class ScreenshotWriter {
+private:
+	// The most captures held at once. Further captures are dropped until the
+	// writer catches up.
+	static const size_t MAX_SHOTS = 4;
+
+	// A captured frame.
+	struct Shot {
+		std::string filename;
+		std::vector<Uint32> pixels;
+		int x_res = 0;
+		int y_res = 0;
+	};
+
+	// The number of pixels of a spare buffer.
+	size_t spare_size;
+
+	// Captures not yet handed to the writer.
+	std::deque<Shot> pending;
+
+	// The timestamp of the last capture.
+	Uint64 last_millis = 0;
+
+	BackgroundWriter<Shot> writer;
+
+	// Write a round of captures.
+	static void write(std::deque<Shot>& shots) {
+		for (Shot& shot: shots) {
+			if (!Png::write(shot.filename, shot.pixels.data(), shot.x_res, shot.y_res, shot.x_res)) {
+				fprintf(stderr, "Could not write \"%s\".\n", shot.filename.c_str());
+			}
+		}
+	}
+
+public:
+	// Default constructor. Spare buffers hold frames of the given number of
+	// pixels.
+	ScreenshotWriter(size_t frame_size):
+		spare_size(frame_size),
+		writer(MAX_SHOTS, write, [this](Shot& shot) { shot.pixels.resize(spare_size); })
+	{
+	}
+
+	// Destructor. Waits for every capture to be written.
+	~ScreenshotWriter() {
+		flush();
+		for (Shot& shot: pending) {
+			writer.push(shot);
+		}
+		writer.stop();
+	}
+
+	ScreenshotWriter(const ScreenshotWriter&) = delete;
+	ScreenshotWriter& operator=(const ScreenshotWriter&) = delete;
+
+	// Capture the video memory of an adapter to export<milliseconds>.png,
+	// named after the wall clock in milliseconds and never the same as the
+	// last. Returns false if too many captures are still being written.
+	bool capture(Graphics& adapter) {
+		if (pending.size() + writer.backlog() >= MAX_SHOTS) {
+			return false;
+		}
+		Shot shot;
+		writer.take_spare(shot);
+		Uint64 millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+		last_millis = std::max(millis, last_millis + 1);
+		char filename[32];
+		snprintf(filename, sizeof(filename), "export%013llu.png", (unsigned long long)last_millis);
+		shot.filename = filename;
+		shot.x_res = adapter.x_res;
+		shot.y_res = adapter.y_res;
+		adapter.snapshot(shot.pixels);
+		pending.push_back(std::move(shot));
+		flush();
+		return true;
+	}
+
+	// Hand the captures so far to the writer thread, unless it is busy.
+	void flush() {
+		while (!pending.empty() && writer.offer(pending.front())) {
+			pending.pop_front();
+		}
+	}
+};
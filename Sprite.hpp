@@ -1,3 +1,7 @@
+#include <vector>
+#include <memory>
+#include <algorithm>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -6,62 +10,198 @@ Uint32 rgb888(Uint8 r, Uint8 g, Uint8 b) {
 	return 0xFF000000 | r << 16 | g << 8 | b;
 }
 
-// A sprite.
+// A sprite sheet built into the executable (see Embed.cpp).
+struct EmbeddedSheet {
+	const Uint32* data;
+	int x_res;
+	int y_res;
+};
+
+// A sprite. Sprites loaded from files share ownership of their pixels, and
+// all other sprites are views of pixels owned by something else, so sprites
+// are cheap to copy and never leak.
 class Sprite {
+private:
+	// The owner of the pixels, if the sprite was loaded from a file.
+	std::shared_ptr<const Uint32> owner;
+
 public:
-	Uint32* data;
+	const Uint32* data;
 	int x_res;
 	int y_res;
 	int channels;
 
+	// Palette indices of the pixels, for indexed video memory. Only sprites
+	// packed into an atlas with a palette have them.
+	const Uint8* indices = nullptr;
+
 	// Null constructor.
 	Sprite() {
 		data = nullptr;
 	}
 
-	// Default constructor (load from file).
+	// Default constructor (load from file). If the file can't be loaded, the
+	// failure is printed and the sprite has no pixels. It doesn't exit, as
+	// sprites are loaded on worker threads.
 	Sprite(std::string path) {
 		// Load the sprite from a file.
 		unsigned char* raw_data = stbi_load(path.c_str(), &x_res, &y_res, &channels, 3);
 		if (!raw_data) {
 			fprintf(stderr, "Could not load sprite \"%s\".\n", path.c_str());
-			exit(EXIT_FAILURE);
+			data = nullptr;
+			return;
 		}
 
 		// Convert the sprite to an optimized format.
-		data = new Uint32[x_res * y_res];
+		Uint32* pixels = new Uint32[x_res * y_res];
 		for (int y = 0; y < y_res; y++) {
 			for (int x = 0; x < x_res; x++) {
 				unsigned char* raw_pixel = raw_data + (y * x_res + x) * 3;
 				Uint8 r = raw_pixel[0];
 				Uint8 g = raw_pixel[1];
 				Uint8 b = raw_pixel[2];
-				data[y * x_res + x] = rgb888(r, g, b);
+				pixels[y * x_res + x] = rgb888(r, g, b);
 			}
 		}
+		owner.reset(pixels, std::default_delete<const Uint32[]>());
+		data = pixels;
 
 		// Free the original sprite.
 		stbi_image_free(raw_data);
 	}
 
-	// Section constructor (load from another sprite).
-	Sprite(Sprite sheet,
-		   int top_left_x,
-		   int top_left_y,
-		   int x_res,
-		   int y_res)
-	{
+	// Embedded constructor. The sprite refers to the embedded pixels, which
+	// are already in the optimized format, so nothing is copied.
+	Sprite(const EmbeddedSheet& sheet) {
+		data = sheet.data;
+		x_res = sheet.x_res;
+		y_res = sheet.y_res;
+		channels = 3;
+	}
+
+	// View constructor. The sprite refers to pixels owned by something else.
+	Sprite(const Uint32* data, int x_res, int y_res) {
+		this->data = data;
 		this->x_res = x_res;
 		this->y_res = y_res;
-		data = new Uint32[x_res * y_res];
+		channels = 3;
+	}
+};
 
-		// Copy a section of the sprite sheet to this sprite.
-		for (int y = 0; y < y_res; y++) {
-			for (int x = 0; x < x_res; x++) {
-				int u = x + top_left_x;
-				int v = y + top_left_y;
-				data[y * x_res + x] = sheet.data[v * sheet.x_res + u];
+// An atlas of sprites, packed into one contiguous block of memory. Sections
+// of sprite sheets are queued with add(), then copied into the block by
+// pack(), which makes a single allocation. Sprites are views into the block,
+// each starting on a cache line. Given a palette, pack() also makes a block
+// of palette indices for indexed video memory.
+class Atlas {
+private:
+	// A queued section of a sprite sheet.
+	struct Section {
+		Sprite sheet;
+		int top_left_x;
+		int top_left_y;
+		int x_res;
+		int y_res;
+		Sprite* sprite;
+	};
+	std::vector<Section> sections;
+
+	// The block of memory, and the block of palette indices, with the
+	// allocations they start in.
+	Uint32* block = nullptr;
+	Uint8* index_block = nullptr;
+	void* block_memory = nullptr;
+	void* index_memory = nullptr;
+
+	// The size of a cache line.
+	static const size_t CACHE_LINE = 64;
+
+	// Round a pixel count up to a whole number of cache lines.
+	static inline size_t align(size_t pixels, size_t pixel_size = sizeof(Uint32)) {
+		size_t alignment = CACHE_LINE / pixel_size;
+		return (pixels + alignment - 1) / alignment * alignment;
+	}
+
+	// Allocate memory that starts on a cache line. malloc() only aligns to
+	// the largest fundamental type, which is narrower, so the allocation is
+	// one cache line larger and the start is rounded up.
+	static void* alloc_lines(size_t size, void*& memory) {
+		memory = malloc(size + CACHE_LINE - 1);
+		if (!memory) {
+			return nullptr;
+		}
+		return (void*)(((uintptr_t)memory + CACHE_LINE - 1) & ~uintptr_t(CACHE_LINE - 1));
+	}
+
+public:
+	// Null constructor.
+	Atlas() {}
+
+	// An atlas owns its block, so it can't be copied.
+	Atlas(const Atlas&) = delete;
+	Atlas& operator=(const Atlas&) = delete;
+
+	// Destructor.
+	~Atlas() {
+		free(block_memory);
+		free(index_memory);
+	}
+
+	// Queue a section of a sprite sheet. The sprite is set by pack().
+	void add(const Sprite& sheet,
+			 int top_left_x,
+			 int top_left_y,
+			 int x_res,
+			 int y_res,
+			 Sprite* sprite)
+	{
+		sections.push_back({sheet, top_left_x, top_left_y, x_res, y_res, sprite});
+	}
+
+	// Copy the queued sections into the block and point their sprites at
+	// them. Sections queued one after another are laid out one after
+	// another. Colors missing from the palette, if any, are added to it.
+	void pack(Palette* palette = nullptr) {
+		size_t pixels = 0;
+		size_t indices = 0;
+		for (Section& section: sections) {
+			pixels += align(section.x_res * section.y_res);
+			indices += align(section.x_res * section.y_res, sizeof(Uint8));
+		}
+		free(block_memory);
+		free(index_memory);
+		index_memory = nullptr;
+		block = (Uint32*)alloc_lines(pixels * sizeof(Uint32), block_memory);
+		index_block = palette ? (Uint8*)alloc_lines(indices, index_memory) : nullptr;
+		if (!block || (palette && !index_block)) {
+			fprintf(stderr, "Could not allocate the sprite atlas.\n");
+			exit(EXIT_FAILURE);
+		}
+
+		Uint32* cursor = block;
+		Uint8* index_cursor = index_block;
+		for (Section& section: sections) {
+			// Copy the section of the sprite sheet to the block.
+			for (int y = 0; y < section.y_res; y++) {
+				const Uint32* row = section.sheet.data + (y + section.top_left_y) * section.sheet.x_res + section.top_left_x;
+				std::copy(row, row + section.x_res, cursor + y * section.x_res);
+			}
+			*section.sprite = Sprite(cursor, section.x_res, section.y_res);
+			if (palette) {
+				// Look up the palette index of every pixel.
+				for (int i = 0; i < section.x_res * section.y_res; i++) {
+					int index = palette->index(cursor[i]);
+					if (index < 0) {
+						fprintf(stderr, "The sprites have too many colors for indexed video memory.\n");
+						exit(EXIT_FAILURE);
+					}
+					index_cursor[i] = index;
+				}
+				section.sprite->indices = index_cursor;
+				index_cursor += align(section.x_res * section.y_res, sizeof(Uint8));
 			}
+			cursor += align(section.x_res * section.y_res);
 		}
+		sections.clear();
 	}
 };
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// A completed game.
+struct GameResult {
+	// The mode: the size of the board and its mines.
+	int x_cells = 0;
+	int y_cells = 0;
+	int mines = 0;
+	// Whether the game was won, after how many milliseconds.
+	bool won = false;
+	Uint32 elapsed = 0;
+	// The board's 3BV (see count_3bv()), or zero if it wasn't counted, and
+	// the number of uncovers and flags it took.
+	Uint64 bbbv = 0;
+	Uint32 clicks = 0;
+	// The seed of the game board.
+	Uint64 seed = 0;
+	// When the game ended, in seconds since the epoch.
+	Uint64 time = 0;
+};
+
+// The statistics of the games of a mode.
+struct ModeStats {
+	Uint64 games = 0;
+	Uint64 wins = 0;
+	// The best time, and the times of the wins in the order they were won.
+	Uint32 best = 0;
+	std::vector<Uint32> times;
+	// The current run of wins, and the longest.
+	Uint64 streak = 0;
+	Uint64 best_streak = 0;
+
+	// Add a game.
+	void add(const GameResult& result) {
+		games++;
+		if (result.won) {
+			best = wins ? std::min(best, result.elapsed) : result.elapsed;
+			wins++;
+			times.push_back(result.elapsed);
+			streak++;
+			best_streak = std::max(best_streak, streak);
+			sorted.clear();
+		} else {
+			streak = 0;
+		}
+	}
+
+	// The time that a fraction of the wins were at least as fast as, from 0
+	// (the best time) to 1 (the worst). The times are sorted on the first
+	// query after a win, not while the statistics are loaded.
+	Uint32 percentile(double fraction) {
+		if (times.empty()) {
+			return 0;
+		}
+		if (sorted.size() != times.size()) {
+			sorted = times;
+			std::sort(sorted.begin(), sorted.end());
+		}
+		return sorted[size_t(fraction * (sorted.size() - 1) + 0.5)];
+	}
+
+private:
+	std::vector<Uint32> sorted;
+};
+
+// A local store of completed games. The file starts with the magic
+// "MSWPSTAT" and a version, followed by a record per game, appended as each
+// game ends and never rewritten. A record is varints of the width, height,
+// mines, result, elapsed milliseconds, 3BV and clicks, the 64-bit
+// little-endian seed, and a zigzag varint of the seconds since the previous
+// record ended, so most records take about 20 bytes.
+//
+// The index of each mode's statistics is kept in memory only, and rebuilt
+// by a sequential scan of the file when the store is opened.
+class StatsStore {
+public:
+	static const Uint32 VERSION = 1;
+
+private:
+	std::string filename;
+
+	// The size of the file up to its last whole record, and whether the file
+	// has to be cut back to there before appending, after a write was cut
+	// short by a crash or failed.
+	size_t size = 0;
+	bool repair = false;
+
+	// The time of the last record.
+	Uint64 last_time = 0;
+
+	// The statistics of each mode.
+	std::map<std::tuple<int, int, int>, ModeStats> modes;
+	ModeStats* last_mode = NULL;
+	std::tuple<int, int, int> last_key;
+
+	// Encode a record.
+	void put_record(std::vector<Uint8>& out, const GameResult& result) {
+		put_varint(out, result.x_cells);
+		put_varint(out, result.y_cells);
+		put_varint(out, result.mines);
+		put_varint(out, result.won);
+		put_varint(out, result.elapsed);
+		put_varint(out, result.bbbv);
+		put_varint(out, result.clicks);
+		put_le(out, result.seed, 8);
+		put_varint(out, zigzag(result.time - last_time));
+		last_time = result.time;
+	}
+
+	// Decode a record. Returns false if it is cut short.
+	bool get_record(Reader& in, GameResult& result) {
+		result.x_cells = in.varint();
+		result.y_cells = in.varint();
+		result.mines = in.varint();
+		result.won = in.varint();
+		result.elapsed = in.varint();
+		result.bbbv = in.varint();
+		result.clicks = in.varint();
+		result.seed = in.le(8);
+		result.time = last_time + unzigzag(in.varint());
+		if (in.ok) {
+			last_time = result.time;
+		}
+		return in.ok;
+	}
+
+	// Add a game to the index. Games mostly come in runs of one mode, so the
+	// mode of the last game is looked up first.
+	void index(const GameResult& result) {
+		std::tuple<int, int, int> key(result.x_cells, result.y_cells, result.mines);
+		if (!last_mode || key != last_key) {
+			last_mode = &modes[key];
+			last_key = key;
+		}
+		last_mode->add(result);
+	}
+
+public:
+	// The number of games in the store.
+	Uint64 games = 0;
+
+	// Default constructor. Reads the file, if any, and builds the index.
+	// Check is_valid() to see if it was a statistics file of this version.
+	StatsStore(std::string filename): filename(filename) {
+		std::vector<Uint8> data;
+		if (!read_file(filename, data) || data.empty()) {
+			return;
+		}
+		Reader in(data.data(), data.size());
+		const Uint8* magic = in.skip(8);
+		if (!magic || memcmp(magic, "MSWPSTAT", 8) != 0 || in.le(4) != VERSION) {
+			this->filename.clear();
+			return;
+		}
+		size = in.data - data.data();
+		GameResult result;
+		while (in.data != in.end) {
+			if (!get_record(in, result)) {
+				// A write was cut short. Drop it.
+				repair = true;
+				break;
+			}
+			index(result);
+			games++;
+			size = in.data - data.data();
+		}
+	}
+
+	// Check if the file is a statistics file of this version, or doesn't
+	// exist yet.
+	bool is_valid() {
+		return !filename.empty();
+	}
+
+	// Append a game to the file and the index. Returns false if the file
+	// can't be written.
+	bool append(const GameResult& result) {
+		if (filename.empty()) {
+			return false;
+		}
+		std::vector<Uint8> out;
+		if (repair) {
+			// Drop the record cut short by a crash or a failed write.
+#ifndef _WIN32
+			if (truncate(filename.c_str(), size) != 0) {
+				return false;
+			}
+#else
+			std::vector<Uint8> data;
+			read_file(filename, data);
+			data.resize(size);
+			if (!write_file(filename, data)) {
+				return false;
+			}
+#endif
+			repair = false;
+		}
+		if (!size) {
+			const char* magic = "MSWPSTAT";
+			out.insert(out.end(), magic, magic + 8);
+			put_le(out, VERSION, 4);
+		}
+		Uint64 previous_time = last_time;
+		put_record(out, result);
+		FILE* file = fopen(filename.c_str(), "ab");
+		bool ok = file != NULL;
+		if (file) {
+			fwrite(out.data(), 1, out.size(), file);
+			ok = !ferror(file);
+			ok = fclose(file) == 0 && ok;
+		}
+		if (!ok) {
+			// Part of the record may have been written, so cut it before the
+			// next one.
+			last_time = previous_time;
+			repair = file != NULL;
+		} else {
+			size += out.size();
+			index(result);
+			games++;
+		}
+		return ok;
+	}
+
+	// The statistics of a mode, or NULL if it has no games.
+	ModeStats* mode(int x_cells, int y_cells, int mines) {
+		auto found = modes.find(std::make_tuple(x_cells, y_cells, mines));
+		return found == modes.end() ? NULL : &found->second;
+	}
+
+	// Print the statistics of every mode.
+	void print() {
+		printf("%-20s %8s %6s %8s %8s %8s %8s\n", "Mode", "Games", "Won", "Best", "Median", "90%", "Streak");
+		for (auto& entry: modes) {
+			ModeStats& stats = entry.second;
+			char mode[32];
+			snprintf(mode, sizeof(mode), "%dx%d, %d mines", std::get<0>(entry.first), std::get<1>(entry.first), std::get<2>(entry.first));
+			printf("%-20s %8llu %5.1f%% %8.2f %8.2f %8.2f %3llu/%-4llu\n", mode,
+				(unsigned long long)stats.games, 100.0 * stats.wins / stats.games,
+				stats.best / 1000.0, stats.percentile(0.5) / 1000.0, stats.percentile(0.9) / 1000.0,
+				(unsigned long long)stats.streak, (unsigned long long)stats.best_streak);
+		}
+	}
+};
\ No newline at end of file
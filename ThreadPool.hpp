@@ -0,0 +1,104 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+
+// A persistent pool of worker threads. The calling thread takes part in
+// every job, so a pool of one thread runs jobs inline.
+class ThreadPool {
+private:
+	// The worker threads.
+	std::vector<std::thread> workers;
+
+	// Synchronization.
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	// The current job.
+	std::function<void(int)> task;
+	int tasks = 0;
+	int next = 0;
+	int remaining = 0;
+	unsigned int generation = 0;
+	bool stopping = false;
+
+	// Run tasks of the current job until there are none left to claim.
+	void drain(std::unique_lock<std::mutex>& lock) {
+		while (next < tasks) {
+			int i = next++;
+			lock.unlock();
+			task(i);
+			lock.lock();
+			if (--remaining == 0) {
+				done.notify_all();
+			}
+		}
+	}
+
+	// Worker thread body.
+	void work() {
+		unsigned int seen = 0;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (1) {
+			wake.wait(lock, [&] { return stopping || generation != seen; });
+			if (stopping) {
+				return;
+			}
+			seen = generation;
+			drain(lock);
+		}
+	}
+
+public:
+	// Default constructor. A thread count of zero uses every core.
+	ThreadPool(int threads = 1) {
+		if (threads <= 0) {
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		}
+		for (int i = 1; i < threads; i++) {
+			workers.emplace_back(&ThreadPool::work, this);
+		}
+	}
+
+	// Destructor.
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& worker: workers) {
+			worker.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// The number of threads that take part in a job.
+	int size() {
+		return workers.size() + 1;
+	}
+
+	// Run task(0) to task(n - 1) across the pool and wait for all of them to
+	// finish.
+	void run(int n, std::function<void(int)> job) {
+		if (workers.empty()) {
+			for (int i = 0; i < n; i++) {
+				job(i);
+			}
+			return;
+		}
+		std::unique_lock<std::mutex> lock(mutex);
+		task = job;
+		tasks = n;
+		next = 0;
+		remaining = n;
+		generation++;
+		wake.notify_all();
+		drain(lock);
+		done.wait(lock, [&] { return remaining == 0; });
+	}
+};
\ No newline at end of file
@@ -0,0 +1,36 @@
+// Render thumbnails of played-out openings of many game boards, without a
+// window. Every thread of the pool renders into its own headless game.
+void render_thumbnails(int x_cells, int y_cells, int mines, Options options) {
+	options.headless = true;
+	ThreadPool pool(options.threads);
+	options.threads = 1;
+
+	// Create a game for each thread, zoomed out so that the whole game board
+	// fits in the thumbnail.
+	std::vector<std::unique_ptr<Minesweeper>> games;
+	for (int t = 0; t < pool.size(); t++) {
+		games.emplace_back(new Minesweeper(x_cells, y_cells, mines, options));
+		games.back()->fit();
+	}
+
+	Uint64 start_ticks = SDL_GetPerformanceCounter();
+	int threads = pool.size();
+	pool.run(threads, [&](int t) {
+		Minesweeper& game = *games[t];
+		for (int i = t; i < options.thumbnails; i += threads) {
+			// Open the game board at its center. Each thumbnail has its own
+			// seed, so the thumbnails don't depend on the number of threads.
+			game.restart(Random::hash(options.seed + i));
+			game.uncover(x_cells / 2, y_cells / 2);
+			game.render();
+			char suffix[16];
+			sprintf(suffix, "%06d.png", i);
+			if (!game.adapter.save_png(options.thumbnail_prefix + suffix)) {
+				fprintf(stderr, "Could not write \"%s%s\".\n", options.thumbnail_prefix.c_str(), suffix);
+				exit(EXIT_FAILURE);
+			}
+		}
+	});
+	double seconds = double(SDL_GetPerformanceCounter() - start_ticks) / SDL_GetPerformanceFrequency();
+	printf("Rendered %d thumbnails in %.2f seconds (%.0f per second, %d threads)\n", options.thumbnails, seconds, options.thumbnails / seconds, threads);
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include <stdio.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// A timeline of named steps, which can be recorded from any thread. Times
+// are measured from the creation of the timeline.
+class Timeline {
+private:
+	// A step and when it began and ended.
+	struct Step {
+		std::string name;
+		Uint64 begin;
+		Uint64 end;
+	};
+
+	// Synchronization.
+	std::mutex mutex;
+
+	// The steps so far.
+	std::vector<Step> steps;
+
+	// The time the timeline was created.
+	Uint64 origin;
+
+	// Convert a time to milliseconds since the timeline was created.
+	double milliseconds(Uint64 ticks) {
+		return double(ticks - origin) * 1000.0 / SDL_GetPerformanceFrequency();
+	}
+
+public:
+	// Default constructor.
+	Timeline(): origin(SDL_GetPerformanceCounter()) {}
+
+	// The current time.
+	Uint64 now() {
+		return SDL_GetPerformanceCounter();
+	}
+
+	// Record a step that began at a time and ends now.
+	void add(std::string name, Uint64 begin) {
+		Uint64 end = now();
+		std::lock_guard<std::mutex> lock(mutex);
+		steps.push_back({name, begin, end});
+	}
+
+	// Print the steps in the order they began, and the longest step.
+	void print() {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<Step> sorted = steps;
+		std::stable_sort(sorted.begin(), sorted.end(), [](const Step& a, const Step& b) {
+			return a.begin < b.begin;
+		});
+		double longest = 0.0;
+		for (const Step& step: sorted) {
+			double begin = milliseconds(step.begin);
+			double end = milliseconds(step.end);
+			longest = std::max(longest, end - begin);
+			printf("%8.2f ms - %8.2f ms (%7.2f ms) %s\n", begin, end, end - begin, step.name.c_str());
+		}
+		printf("Longest step %.2f ms\n", longest);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include <string.h>
+
+// SSE2 is part of every x86-64 processor, so the SIMD pixel duplication is
+// compiled in whenever the compiler targets it.
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Stretch a row of n pixels to n * factor pixels by repeating each pixel
+// (nearest neighbour).
+inline void upscale_row(const Uint32* in, Uint32* out, int n, int factor) {
+	int i = 0;
+#ifdef __SSE2__
+	// Duplicate 4 pixels at a time with 32-bit shuffles.
+	if (factor == 2) {
+		for (; i + 4 <= n; i += 4) {
+			__m128i p = _mm_loadu_si128((const __m128i*)(in + i));
+			_mm_storeu_si128((__m128i*)(out + i * 2 + 0), _mm_unpacklo_epi32(p, p));
+			_mm_storeu_si128((__m128i*)(out + i * 2 + 4), _mm_unpackhi_epi32(p, p));
+		}
+	} else if (factor == 3) {
+		for (; i + 4 <= n; i += 4) {
+			__m128i p = _mm_loadu_si128((const __m128i*)(in + i));
+			_mm_storeu_si128((__m128i*)(out + i * 3 + 0), _mm_shuffle_epi32(p, _MM_SHUFFLE(1, 0, 0, 0)));
+			_mm_storeu_si128((__m128i*)(out + i * 3 + 4), _mm_shuffle_epi32(p, _MM_SHUFFLE(2, 2, 1, 1)));
+			_mm_storeu_si128((__m128i*)(out + i * 3 + 8), _mm_shuffle_epi32(p, _MM_SHUFFLE(3, 3, 3, 2)));
+		}
+	} else if (factor == 4) {
+		for (; i + 4 <= n; i += 4) {
+			__m128i p = _mm_loadu_si128((const __m128i*)(in + i));
+			_mm_storeu_si128((__m128i*)(out + i * 4 +  0), _mm_shuffle_epi32(p, _MM_SHUFFLE(0, 0, 0, 0)));
+			_mm_storeu_si128((__m128i*)(out + i * 4 +  4), _mm_shuffle_epi32(p, _MM_SHUFFLE(1, 1, 1, 1)));
+			_mm_storeu_si128((__m128i*)(out + i * 4 +  8), _mm_shuffle_epi32(p, _MM_SHUFFLE(2, 2, 2, 2)));
+			_mm_storeu_si128((__m128i*)(out + i * 4 + 12), _mm_shuffle_epi32(p, _MM_SHUFFLE(3, 3, 3, 3)));
+		}
+	}
+#endif
+	for (; i < n; i++) {
+		for (int k = 0; k < factor; k++) {
+			out[i * factor + k] = in[i];
+		}
+	}
+}
+
+// Stretch rows of pixels by an integer factor in both directions. Each
+// output row is stretched once and then copied to the rows below it. The
+// pitches are in bytes.
+inline void upscale(const Uint32* in, int in_pitch, Uint8* out, int out_pitch, int x_res, int rows, int factor) {
+	for (int y = 0; y < rows; y++) {
+		const Uint32* in_row = (const Uint32*)((const Uint8*)in + y * in_pitch);
+		Uint8* out_row = out + y * factor * out_pitch;
+		upscale_row(in_row, (Uint32*)out_row, x_res, factor);
+		for (int k = 1; k < factor; k++) {
+			memcpy(out_row + k * out_pitch, out_row, x_res * factor * sizeof(Uint32));
+		}
+	}
+}
\ No newline at end of file
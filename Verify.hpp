@@ -0,0 +1,118 @@
+// Replay recorded games without rendering, across every thread of the pool,
+// and check that each ends as recorded: won, lost or unfinished, and after
+// the same number of milliseconds. Prints every divergence and returns true
+// if there were none.
+bool verify_replays(std::vector<std::string> files, Options options) {
+	options.headless = true;
+	// The games only replay: they don't record, write a video, load a game
+	// or open a board file, which would be shared by every thread.
+	options.record.clear();
+	options.video.clear();
+	options.load.clear();
+	options.board_file.clear();
+	ThreadPool pool(options.threads);
+	options.threads = 1;
+
+	// A recorded game: a range of the records of a file.
+	struct Game {
+		int file;
+		size_t begin;
+		size_t end;
+	};
+
+	// Read the files and find where each game starts.
+	Uint64 start_ticks = SDL_GetPerformanceCounter();
+	std::vector<std::vector<Uint8>> data(files.size());
+	std::vector<Game> games;
+	for (size_t f = 0; f < files.size(); f++) {
+		size_t header = 0;
+		if (read_file(files[f], data[f])) {
+			header = ReplayReader::skip_header(data[f]);
+		}
+		if (!header) {
+			fprintf(stderr, "Could not read \"%s\".\n", files[f].c_str());
+			return false;
+		}
+		ReplayReader reader(data[f].data() + header, data[f].size() - header);
+		ReplayRecord record;
+		size_t offset = reader.offset();
+		while (reader.next(record)) {
+			if (record.kind == REPLAY_GAME) {
+				if (!games.empty() && games.back().file == int(f)) {
+					games.back().end = header + offset;
+				}
+				games.push_back({int(f), header + offset, data[f].size()});
+			} else if (games.empty() || games.back().file != int(f)) {
+				// An action before the first game.
+				break;
+			}
+			offset = reader.offset();
+		}
+		if (!reader.is_valid() || offset != data[f].size() - header) {
+			fprintf(stderr, "\"%s\" is not a valid replay (at byte %zu).\n", files[f].c_str(), header + offset);
+			return false;
+		}
+	}
+
+	// Create a game for each thread. They are never rendered.
+	std::vector<std::unique_ptr<Minesweeper>> engines;
+	for (int t = 0; t < pool.size(); t++) {
+		engines.emplace_back(new Minesweeper(9, 9, 10, options));
+		engines.back()->track_minimap = false;
+	}
+
+	// The divergences found by each thread.
+	int threads = pool.size();
+	std::vector<std::vector<std::string>> divergences(threads);
+	pool.run(threads, [&](int t) {
+		Minesweeper& engine = *engines[t];
+		for (size_t i = t; i < games.size(); i += threads) {
+			const Game& game = games[i];
+			ReplayReader reader(data[game.file].data() + game.begin, game.end - game.begin);
+			ReplayRecord record;
+			reader.next(record);
+			engine.resize(record.x_cells, record.y_cells, record.mines);
+			engine.restart(record.seed);
+
+			// Perform every action up to the result, if any.
+			int result = -1;
+			Uint32 elapsed = 0;
+			while (reader.next(record)) {
+				if (record.kind == REPLAY_WIN || record.kind == REPLAY_LOSS) {
+					result = record.kind;
+					elapsed = record.elapsed;
+					break;
+				}
+				engine.act(record.kind, record.cell, record.ticks);
+			}
+
+			// Compare the results.
+			int replayed = -1;
+			Uint32 replayed_elapsed = 0;
+			if (engine.state == engine.GAME_WINNER || engine.state == engine.GAME_LOSER) {
+				replayed = engine.state == engine.GAME_WINNER ? REPLAY_WIN : REPLAY_LOSS;
+				replayed_elapsed = engine.end_ticks - engine.start_ticks;
+			}
+			if (replayed != result || replayed_elapsed != elapsed) {
+				static const char* names[] = {"unfinished", "won", "lost"};
+				char message[256];
+				snprintf(message, sizeof(message), "Game at byte %zu of \"%s\" diverged: recorded %s after %u ms, replayed %s after %u ms",
+					game.begin, files[game.file].c_str(),
+					names[result < 0 ? 0 : result - REPLAY_WIN + 1], elapsed,
+					names[replayed < 0 ? 0 : replayed - REPLAY_WIN + 1], replayed_elapsed);
+				divergences[t].push_back(message);
+			}
+		}
+	});
+
+	int diverged = 0;
+	for (const std::vector<std::string>& messages: divergences) {
+		for (const std::string& message: messages) {
+			fprintf(stderr, "%s\n", message.c_str());
+			diverged++;
+		}
+	}
+	double seconds = double(SDL_GetPerformanceCounter() - start_ticks) / SDL_GetPerformanceFrequency();
+	printf("Verified %zu games in %.2f seconds (%.0f per second, %d threads), %d diverged\n", games.size(), seconds, games.size() / seconds, threads, diverged);
+	return diverged == 0;
+}
\ No newline at end of file
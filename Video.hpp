@@ -0,0 +1,360 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+// Video files. A video file starts with the magic "MSWPVIDE", a version and
+// the width and height of its frames, followed by frames. Each frame is a
+// varint of milliseconds since the previous frame and a varint of the number
+// of tiles that changed since the previous frame, followed by the changed
+// tiles. Tiles are 16x16 pixels in row-major order (smaller at the right
+// and bottom edges), and each is a varint of the number of unchanged tiles
+// before it, followed by runs of its pixels in row-major order. A run is a
+// varint of its length minus one, shifted left by one, with the low bit set
+// if it is followed by the 24-bit little-endian color of its pixels, or
+// clear if its pixels are the same as in the previous frame.
+//
+// Between frames only the board's changed cells, the counters and the smiley
+// usually change, and those are mostly flat colors, so most frames take a
+// few bytes and a whole game a few hundred kilobytes.
+
+// Records presented frames to a video file. A capture copies the video
+// memory into a spare buffer and queues it for a writer thread, which finds
+// the changed tiles and writes them, so the frame loop never waits for the
+// diffing or the disk. If the writer falls behind, frames are dropped; the
+// next frame written still has its own time.
+class VideoWriter {
+public:
+	static const Uint32 VERSION = 1;
+	static const int TILE_SIZE = 16;
+
+private:
+	// The most frames waiting for the writer.
+	static const size_t MAX_FRAMES = 8;
+
+	// A captured frame.
+	struct Frame {
+		Uint32 ticks = 0;
+		std::vector<Uint32> pixels;
+	};
+
+	std::string filename;
+	FILE* file = NULL;
+	bool failed = false;
+	int x_res;
+	int y_res;
+
+	// Frames not yet handed to the writer, and the number of frames dropped.
+	std::deque<Frame> pending;
+	int dropped = 0;
+
+	// The last frame written, and its time. Only the writer uses these.
+	std::vector<Uint32> previous;
+	Uint32 previous_ticks = 0;
+	std::vector<Uint8> out;
+
+	BackgroundWriter<Frame> writer;
+
+	// Write a round of frames. Each frame's buffer is swapped with the
+	// previous frame's, which becomes a spare.
+	void write(std::deque<Frame>& frames) {
+		for (Frame& frame: frames) {
+			put_frame(frame);
+			fwrite(out.data(), 1, out.size(), file);
+			std::swap(previous, frame.pixels);
+		}
+		if (ferror(file)) {
+			fail();
+		}
+	}
+
+	// Report the first failure to write the file.
+	void fail() {
+		if (!failed) {
+			fprintf(stderr, "Could not write \"%s\", so the video is incomplete.\n", filename.c_str());
+			failed = true;
+		}
+	}
+
+	// Encode the tiles of a frame that differ from the previous frame.
+	void put_frame(const Frame& frame) {
+		out.clear();
+		put_varint(out, previous.empty() ? 0 : frame.ticks - previous_ticks);
+		previous_ticks = frame.ticks;
+		std::vector<Uint8> tiles;
+		int changed = 0;
+		int skipped = 0;
+		const int size = TILE_SIZE;
+		for (int y = 0; y < y_res; y += size) {
+			int h = std::min(size, y_res - y);
+			for (int x = 0; x < x_res; x += size) {
+				int w = std::min(size, x_res - x);
+				const Uint32* pixels = frame.pixels.data() + size_t(y) * x_res + x;
+				const Uint32* before = previous.empty() ? NULL : previous.data() + size_t(y) * x_res + x;
+				if (before && same_tile(pixels, before, w, h)) {
+					skipped++;
+					continue;
+				}
+				put_varint(tiles, skipped);
+				put_tile(tiles, pixels, before, w, h);
+				skipped = 0;
+				changed++;
+			}
+		}
+		put_varint(out, changed);
+		out.insert(out.end(), tiles.begin(), tiles.end());
+	}
+
+	// Check if a tile of w by h pixels is the same in two frames.
+	bool same_tile(const Uint32* pixels, const Uint32* before, int w, int h) {
+		for (int j = 0; j < h; j++) {
+			if (memcmp(pixels + size_t(j) * x_res, before + size_t(j) * x_res, w * sizeof(Uint32)) != 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Encode the runs of a tile of w by h pixels. Without a previous frame
+	// every run has a color.
+	void put_tile(std::vector<Uint8>& tiles, const Uint32* pixels, const Uint32* before, int w, int h) {
+		int run = 0;
+		bool unchanged = false;
+		Uint32 color = 0;
+		for (int j = 0; j < h; j++) {
+			for (int i = 0; i < w; i++) {
+				Uint32 pixel = pixels[size_t(j) * x_res + i] & 0xFFFFFF;
+				bool same = before && pixel == (before[size_t(j) * x_res + i] & 0xFFFFFF);
+				if (run && (same ? unchanged : !unchanged && pixel == color)) {
+					run++;
+					continue;
+				}
+				if (run) {
+					put_run(tiles, run, unchanged, color);
+				}
+				run = 1;
+				unchanged = same;
+				color = pixel;
+			}
+		}
+		put_run(tiles, run, unchanged, color);
+	}
+
+	// Encode a run.
+	void put_run(std::vector<Uint8>& tiles, int run, bool unchanged, Uint32 color) {
+		put_varint(tiles, Uint64(run - 1) << 1 | !unchanged);
+		if (!unchanged) {
+			put_le(tiles, color, 3);
+		}
+	}
+
+public:
+	// Default constructor. Check is_open() to see if the file was created.
+	VideoWriter(std::string filename, int x_res, int y_res):
+		filename(filename),
+		x_res(x_res),
+		y_res(y_res),
+		writer(
+			MAX_FRAMES,
+			[this](std::deque<Frame>& frames) { write(frames); },
+			[this](Frame& frame) { frame.pixels.resize(size_t(this->x_res) * this->y_res); },
+			MAX_FRAMES
+		)
+	{
+		file = fopen(filename.c_str(), "wb");
+		if (!file) {
+			return;
+		}
+		std::vector<Uint8> header;
+		const char* magic = "MSWPVIDE";
+		header.insert(header.end(), magic, magic + 8);
+		put_le(header, VERSION, 4);
+		put_le(header, x_res, 4);
+		put_le(header, y_res, 4);
+		if (fwrite(header.data(), 1, header.size(), file) != header.size()) {
+			fail();
+		}
+	}
+
+	// Destructor. Waits for every frame to be written.
+	~VideoWriter() {
+		if (!file) {
+			return;
+		}
+		for (Frame& frame: pending) {
+			writer.push(frame);
+		}
+		writer.stop();
+		bool ok = !ferror(file);
+		ok = fclose(file) == 0 && ok;
+		if (!ok) {
+			fail();
+		}
+		if (dropped) {
+			fprintf(stderr, "Dropped %d video frames.\n", dropped);
+		}
+	}
+
+	VideoWriter(const VideoWriter&) = delete;
+	VideoWriter& operator=(const VideoWriter&) = delete;
+
+	// Check if the file was created.
+	bool is_open() {
+		return file != NULL;
+	}
+
+	// Capture the video memory of an adapter as a frame at a time in
+	// milliseconds, into a spare buffer if the writer has one ready, and hand
+	// the frames so far to the writer thread unless it is busy.
+	void capture(Graphics& adapter, Uint32 ticks) {
+		if (!file) {
+			return;
+		}
+		if (pending.size() + writer.backlog() >= MAX_FRAMES) {
+			dropped++;
+			return;
+		}
+		Frame frame;
+		writer.take_spare(frame);
+		frame.ticks = ticks;
+		adapter.snapshot(frame.pixels);
+		pending.push_back(std::move(frame));
+		while (!pending.empty() && writer.offer(pending.front())) {
+			pending.pop_front();
+		}
+	}
+};
+
+// Reads the frames of a video file.
+class VideoReader {
+private:
+	Reader in;
+	bool valid = true;
+
+public:
+	// The size of the frames.
+	int x_res = 0;
+	int y_res = 0;
+
+	// The current frame and its time in milliseconds.
+	std::vector<Uint32> pixels;
+	Uint32 ticks = 0;
+
+	// Default constructor. Check is_valid() to see if the buffer holds a
+	// video file of this version.
+	VideoReader(const std::vector<Uint8>& data): in(data.data(), data.size()) {
+		const Uint8* magic = in.skip(8);
+		valid = magic && memcmp(magic, "MSWPVIDE", 8) == 0 && in.le(4) == VideoWriter::VERSION;
+		x_res = in.le(4);
+		y_res = in.le(4);
+		valid = valid && in.ok && x_res > 0 && y_res > 0 && x_res <= 16384 && y_res <= 16384;
+		if (valid) {
+			pixels.assign(size_t(x_res) * y_res, 0);
+		}
+	}
+
+	// Read the next frame. Returns false at the end of the file or at an
+	// invalid frame, which is_valid() tells apart.
+	bool next() {
+		if (!valid || in.data == in.end) {
+			return false;
+		}
+		ticks += in.varint();
+		Uint64 changed = in.varint();
+		const int size = VideoWriter::TILE_SIZE;
+		int x_tiles = (x_res + size - 1) / size;
+		Uint64 tiles = Uint64(x_tiles) * ((y_res + size - 1) / size);
+		Uint64 tile = 0;
+		for (Uint64 t = 0; t < changed && valid; t++) {
+			tile += in.varint();
+			if (!in.ok || tile >= tiles) {
+				valid = false;
+				break;
+			}
+			int x = tile % x_tiles * size;
+			int y = tile / x_tiles * size;
+			valid = get_tile(x, y, std::min(size, x_res - x), std::min(size, y_res - y));
+			tile++;
+		}
+		valid = valid && in.ok;
+		return valid;
+	}
+
+	// Check if every frame read so far was valid.
+	bool is_valid() {
+		return valid;
+	}
+
+private:
+	// Decode the runs of the tile of w by h pixels at x, y.
+	bool get_tile(int x, int y, int w, int h) {
+		int i = 0;
+		while (i < w * h) {
+			Uint64 head = in.varint();
+			Uint64 run = (head >> 1) + 1;
+			if (!in.ok || run > Uint64(w * h - i)) {
+				return false;
+			}
+			if (head & 1) {
+				Uint32 color = in.le(3) | 0xFF000000;
+				for (int end = i + run; i < end; i++) {
+					pixels[size_t(y + i / w) * x_res + x + i % w] = color;
+				}
+			} else {
+				i += run;
+			}
+		}
+		return true;
+	}
+};
+
+// Export the frames of a video file as PNG files named <prefix>NNNNNN.png, at
+// a constant rate of fps frames per second, for transcoding. Each exported
+// frame shows the last recorded frame at its time. Returns false if the file
+// can't be read or written.
+bool export_video(std::string filename, std::string prefix, int fps) {
+	std::vector<Uint8> data;
+	if (!read_file(filename, data)) {
+		fprintf(stderr, "Could not read \"%s\".\n", filename.c_str());
+		return false;
+	}
+	VideoReader reader(data);
+	if (!reader.is_valid() || !reader.next()) {
+		fprintf(stderr, "\"%s\" is not a valid video.\n", filename.c_str());
+		return false;
+	}
+	fps = fps > 0 ? fps : 60;
+	Uint64 start_ticks = SDL_GetPerformanceCounter();
+	int recorded = 1;
+	int exported = 0;
+	std::vector<Uint32> shown = reader.pixels;
+	bool more = reader.next();
+	while (1) {
+		// Show the last frame recorded by the time of this exported frame.
+		Uint32 at = Uint64(exported) * 1000 / fps;
+		while (more && reader.ticks <= at) {
+			shown = reader.pixels;
+			recorded++;
+			more = reader.next();
+		}
+		char suffix[16];
+		sprintf(suffix, "%06d.png", exported);
+		if (!Png::write(prefix + suffix, shown.data(), reader.x_res, reader.y_res, reader.x_res)) {
+			fprintf(stderr, "Could not write \"%s%s\".\n", prefix.c_str(), suffix);
+			return false;
+		}
+		exported++;
+		if (!more) {
+			break;
+		}
+	}
+	if (!reader.is_valid()) {
+		fprintf(stderr, "\"%s\" is truncated after %d frames.\n", filename.c_str(), recorded);
+	}
+	double seconds = double(SDL_GetPerformanceCounter() - start_ticks) / SDL_GetPerformanceFrequency();
+	printf("Exported %d frames of %d recorded in %.2f seconds\n", exported, recorded, seconds);
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <deque>
+#include <vector>
+
+// A writer thread that works through items handed to it by the game, so
+// that the game never waits on encoding or the disk. The game hands items
+// over with offer(), which gives up rather than wait for the lock, and keeps
+// what it couldn't hand over for the next try. The writer takes every
+// waiting item at once and writes them as a round without holding the
+// lock.
+//
+// A writer can also keep spare items, such as frame buffers, for the game
+// to fill: written items are kept as spares, and when there are none the
+// writer prepares one before writing, so that the game rarely allocates.
+template <typename Item>
+class BackgroundWriter {
+public:
+	// Writes a round of items on the writer thread.
+	typedef std::function<void(std::deque<Item>&)> Write;
+	// Prepares a spare item on the writer thread.
+	typedef std::function<void(Item&)> Prepare;
+
+private:
+	Write write;
+	Prepare prepare;
+
+	// The most items waiting for the writer, and the most spares kept.
+	size_t max_items;
+	size_t max_spares;
+
+	std::thread writer;
+
+	// Synchronization.
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable room;
+
+	// Items waiting for the writer, and spares.
+	std::deque<Item> items;
+	std::vector<Item> spares;
+	bool stopping = false;
+
+	// The number of items waiting or being written.
+	std::atomic<size_t> backlog_size;
+
+	// Writer thread body.
+	void work() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (1) {
+			wake.wait(lock, [&] { return stopping || !items.empty() || (prepare && spares.empty()); });
+			if (prepare && spares.empty() && !stopping) {
+				lock.unlock();
+				Item spare;
+				prepare(spare);
+				lock.lock();
+				spares.push_back(std::move(spare));
+				continue;
+			}
+			if (items.empty()) {
+				return;
+			}
+			std::deque<Item> round;
+			std::swap(round, items);
+			lock.unlock();
+			room.notify_all();
+			write(round);
+			lock.lock();
+			backlog_size -= round.size();
+			if (prepare) {
+				for (Item& item: round) {
+					if (spares.size() < max_spares) {
+						spares.push_back(std::move(item));
+					}
+				}
+			}
+		}
+	}
+
+	// Queue an item. The lock must be held.
+	void queue(Item& item) {
+		items.push_back(std::move(item));
+		backlog_size++;
+	}
+
+public:
+	// Default constructor. Starts the writer thread, so an owner should
+	// declare its writer after everything the callbacks use. Spares are only
+	// kept with a prepare callback.
+	BackgroundWriter(size_t max_items, Write write, Prepare prepare = Prepare(), size_t max_spares = 1):
+		write(write), prepare(prepare), max_items(max_items), max_spares(max_spares), backlog_size(0)
+	{
+		writer = std::thread(&BackgroundWriter::work, this);
+	}
+
+	// Destructor. Waits for every item to be written.
+	~BackgroundWriter() {
+		stop();
+	}
+
+	BackgroundWriter(const BackgroundWriter&) = delete;
+	BackgroundWriter& operator=(const BackgroundWriter&) = delete;
+
+	// Hand an item to the writer, unless the lock is taken or too many items
+	// are waiting. With replace, the waiting items are dropped instead, and
+	// only the lock can refuse. Returns true if the item was taken.
+	bool offer(Item& item, bool replace = false) {
+		std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+		if (!lock.owns_lock() || (!replace && items.size() >= max_items)) {
+			return false;
+		}
+		if (replace) {
+			backlog_size -= items.size();
+			items.clear();
+		}
+		queue(item);
+		lock.unlock();
+		wake.notify_one();
+		return true;
+	}
+
+	// Hand an item to the writer, waiting for room if too many items are
+	// waiting.
+	void push(Item& item) {
+		std::unique_lock<std::mutex> lock(mutex);
+		room.wait(lock, [&] { return items.size() < max_items; });
+		queue(item);
+		lock.unlock();
+		wake.notify_one();
+	}
+
+	// Take a spare item, unless the lock is taken or there is none. Returns
+	// true if one was taken.
+	bool take_spare(Item& item) {
+		std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+		if (!lock.owns_lock() || spares.empty()) {
+			return false;
+		}
+		item = std::move(spares.back());
+		spares.pop_back();
+		return true;
+	}
+
+	// The number of items waiting or being written.
+	size_t backlog() {
+		return backlog_size;
+	}
+
+	// Write every waiting item, then stop the writer thread. An owner whose
+	// callbacks use its members stops its writer in its own destructor.
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (stopping) {
+				return;
+			}
+			stopping = true;
+		}
+		wake.notify_one();
+		writer.join();
+	}
+
+	// Hand an item to the writer and stop it (see stop()). The item is
+	// written even if too many items are waiting.
+	void stop(Item& item) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (stopping) {
+				return;
+			}
+			queue(item);
+		}
+		stop();
+	}
+};
@@ -1 +1,14 @@
-clang++ Main.cpp -o Minesweeper.o -std=c++11 `sdl2-config --cflags --libs` && ./Minesweeper.o
\ No newline at end of file
+# Build and run the game. "./build.sh asan" builds with the address and
+# undefined behaviour sanitizers instead of optimizations, and
+# "./build.sh check" builds and runs the round-trip checks of the file
+# formats instead of the game.
+FLAGS="-O2"
+if [ "$1" = "asan" ]; then
+	FLAGS="-O1 -g -fno-omit-frame-pointer -fsanitize=address,undefined"
+fi
+clang++ Embed.cpp -o Embed.o -std=c++11 && ./Embed.o Border.png Tile.png Counter.png Smiley.png Frame.png > Sheets.hpp || exit
+if [ "$1" = "check" ]; then
+	clang++ Check.cpp -o Check.o -std=c++11 -pthread $FLAGS `sdl2-config --cflags --libs` && ./Check.o
+	exit
+fi
+clang++ Main.cpp -o Minesweeper.o -std=c++11 -pthread $FLAGS `sdl2-config --cflags --libs` && ./Minesweeper.o
\ No newline at end of file